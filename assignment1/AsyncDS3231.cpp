@@ -0,0 +1,263 @@
+/*
+ * AsyncDS3231.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "AsyncDS3231.h"
+#include "EdgeSource.h"
+
+using namespace std;
+
+namespace een1071 {
+
+    // Thread-safe: interrupt handlers and the RTC thread post here
+    void RtcExecutor::post(coroutine_handle<> handle) {
+        lock_guard<mutex> lock(m);
+        queue.push_back(handle);
+        ready.notify_one();
+    }
+
+    // Resume posted coroutines on the calling thread until stop()
+    void RtcExecutor::run() {
+        unique_lock<mutex> lock(m);
+        while (true) {
+            ready.wait(lock, [&] { return stopped || !queue.empty(); });
+            if (stopped) return;
+            coroutine_handle<> handle = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+    }
+
+    void RtcExecutor::stop() {
+        lock_guard<mutex> lock(m);
+        stopped = true;
+        ready.notify_all();
+    }
+
+    AsyncDS3231::AsyncDS3231(DS3231 &rtc, RtcExecutor &executor) : rtc(rtc), executor(executor) {
+        thread = std::thread(&AsyncDS3231::run, this);
+    }
+
+    // Coroutines still waiting on an alarm or edge are not resumed
+    AsyncDS3231::~AsyncDS3231() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void AsyncDS3231::submit(RtcOperation *operation) {
+        lock_guard<mutex> lock(m);
+        operation->next = pending;
+        pending = operation;
+        wake.notify_one();
+    }
+
+    /**
+     * Report an INT/SQW falling edge. Safe to call from any thread; only records the edge and
+     * wakes the RTC thread, which resumes the edge waiters and checks the alarm flags.
+     */
+    void AsyncDS3231::onInterrupt(const struct timespec &when) {
+        lock_guard<mutex> lock(m);
+        interrupted = true;
+        interruptTime = when;
+        wake.notify_one();
+    }
+
+    // Matches gpioAlertFuncEx_t: gpioSetAlertFuncEx(INT_SQW_PIN, AsyncDS3231::pigpioAlert, &asyncRtc)
+    void AsyncDS3231::pigpioAlert(int, int level, uint32_t tick, void *self) {
+        if (level != 0) return;  // INT/SQW is active low
+        struct timespec when;
+        tickToRealtime(tick, when);
+        ((AsyncDS3231*)self)->onInterrupt(when);
+    }
+
+    void AsyncDS3231::resume(RtcOperation *operation) {
+        executor.post(operation->handle);
+    }
+
+    void AsyncDS3231::run() {
+        unique_lock<mutex> lock(m);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || pending || interrupted; });
+            if (stopping) return;
+
+            // Take the submitted operations in FIFO order
+            RtcOperation *operations = nullptr;
+            while (pending) {
+                RtcOperation *next = pending->next;
+                pending->next = operations;
+                operations = pending;
+                pending = next;
+            }
+            bool edge = interrupted;
+            struct timespec when = interruptTime;
+            interrupted = false;
+            lock.unlock();
+
+            // The edge is handled first so that a nextEdge() submitted after it waits for the next one
+            if (edge) serviceInterrupt(when);
+            while (operations) {
+                RtcOperation *next = operations->next;   // the operation may be resumed and gone after execute()
+                operations->execute(*this);
+                operations = next;
+            }
+            lock.lock();
+        }
+    }
+
+    void AsyncDS3231::serviceInterrupt(const struct timespec &when) {
+        RtcOperation *waiter = edgeWaiters;
+        edgeWaiters = nullptr;
+        while (waiter) {
+            RtcOperation *next = waiter->next;
+            static_cast<EdgeAwaiter*>(waiter)->when = when;
+            resume(waiter);
+            waiter = next;
+        }
+
+        // Fired flags are cleared even with no one waiting, or INT would stay low for good
+        long long now;
+        unsigned char status;
+        if (readNow(now, &status)) return;
+        unsigned char fired = status & (STATUS_A1F | STATUS_A2F);
+        if (!fired) return;
+        // Alarm flags can only be written to 0, so writing 1 leaves the others as they are
+        rtc.writeRegister(STATUS_REG, (status | STATUS_A1F | STATUS_A2F) & ~fired);
+
+        if (fired & STATUS_A1F) reschedule(0);
+        if (fired & STATUS_A2F) reschedule(1);
+    }
+
+    // Burst-reads the time through STATUS_REG; the RTC calendar time is taken as UTC
+    int AsyncDS3231::readNow(long long &now, unsigned char *status) {
+        unsigned char r[STATUS_REG + 1];
+        if (rtc.readRegistersInto(r, sizeof(r), RTC_SECONDS)) return 1;
+        struct tm t;
+        decodeTimeRegisters(r, t);
+        now = timegm(&t);
+        if (status) *status = r[STATUS_REG];
+        return 0;
+    }
+
+    static bool sameAlarm(const AlarmDescriptor &a, const AlarmDescriptor &b) {
+        return a.alarm == b.alarm && a.rate == b.rate && a.second == b.second && a.minute == b.minute
+                && a.hour == b.hour && a.dayOrDate == b.dayOrDate && a.twelveHour == b.twelveHour;
+    }
+
+    /**
+     * Seconds from `now` until the descriptor next matches, following the chip: alarm 2 has no
+     * seconds register and matches at 00 seconds, and a match in the current second doesn't count.
+     * @return 1 or more, or -1 if it never matches (a date the next two months don't have)
+     */
+    static long long secondsUntil(const AlarmDescriptor &a, long long now) {
+        time_t from = (time_t)now;
+        struct tm t;
+        gmtime_r(&from, &t);
+        long long second = a.alarm == 1 ? a.second : 0;
+        long long ofDay = a.hour * 3600LL + a.minute * 60 + second;
+        long long nowOfDay = t.tm_hour * 3600LL + t.tm_min * 60 + t.tm_sec;
+        long long period, target, current;
+
+        switch (a.rate) {
+        case ALARM_EVERY_SECOND: return 1;
+        case ALARM_EVERY_MINUTE: period = 60; target = 0; current = t.tm_sec; break;
+        case ALARM_MATCH_SECONDS: period = 60; target = second; current = t.tm_sec; break;
+        case ALARM_MATCH_MINUTES: period = 3600; target = a.minute * 60 + second; current = t.tm_min * 60 + t.tm_sec; break;
+        case ALARM_MATCH_HOURS: period = 86400; target = ofDay; current = nowOfDay; break;
+        case ALARM_MATCH_DAY: period = 7 * 86400; target = (a.dayOrDate - 1) * 86400LL + ofDay; current = t.tm_wday * 86400LL + nowOfDay; break;
+        default:
+            // Months differ in length, so walk the days until the date comes round
+            for (int day = 0; day < 62; day++) {
+                struct tm c = t;
+                c.tm_mday += day;
+                c.tm_hour = a.hour;
+                c.tm_min = a.minute;
+                c.tm_sec = second;
+                long long at = timegm(&c);
+                if (c.tm_mday == a.dayOrDate && at > now) return at - now;
+            }
+            return -1;
+        }
+        long long wait = ((target - current) % period + period) % period;
+        return wait ? wait : period;
+    }
+
+    /**
+     * Resume the waiters of one hardware alarm that are due, then program the alarm with the
+     * earliest one left, or disable it when there is none. The time is read again after programming:
+     * a match that happened while the registers were being written would otherwise be missed.
+     */
+    void AsyncDS3231::reschedule(int index) {
+        while (true) {
+            long long now;
+            if (readNow(now, nullptr)) return;
+            RtcOperation *&head = alarmWaiters[index];
+            while (head && static_cast<AlarmAwaiter*>(head)->due <= now) {
+                RtcOperation *next = head->next;   // the waiter may be resumed and gone right away
+                resume(head);
+                head = next;
+            }
+
+            if (!head) {
+                // No waiter left, so stop a repeating alarm from pulling INT low again
+                if (!programmed[index]) return;
+                unsigned char control;
+                if (rtc.readRegistersInto(&control, 1, CONTROL_REG)) return;
+                rtc.writeRegister(CONTROL_REG, control & ~((index == 0 ? CONTROL_A1IE : CONTROL_A2IE) | CONTROL_CONV));
+                programmed[index] = false;
+                return;
+            }
+
+            AlarmAwaiter *earliest = static_cast<AlarmAwaiter*>(head);
+            if (programmed[index] && sameAlarm(programmedAs[index], earliest->descriptor)) return;
+            if (rtc.programAlarm(earliest->descriptor)) {
+                head = earliest->next;
+                earliest->result = 1;
+                resume(earliest);
+                programmed[index] = false;
+                continue;
+            }
+            programmed[index] = true;
+            programmedAs[index] = earliest->descriptor;
+        }
+    }
+
+    void AsyncDS3231::AlarmAwaiter::execute(AsyncDS3231 &owner) {
+        unsigned char regs[4];
+        long long now, wait = -1;
+        if (owner.rtc.encodeAlarm(descriptor, regs) < 0 || owner.readNow(now, nullptr)
+                || (wait = secondsUntil(descriptor, now)) < 0) {
+            result = 1;
+            owner.resume(this);
+            return;
+        }
+        due = now + wait;
+
+        // After the waiters due at the same time or earlier, so equal due times resume in order
+        int index = descriptor.alarm - 1;
+        RtcOperation **link = &owner.alarmWaiters[index];
+        while (*link && static_cast<AlarmAwaiter*>(*link)->due <= due) link = &(*link)->next;
+        next = *link;
+        *link = this;
+        owner.reschedule(index);
+    }
+
+    void AsyncDS3231::EdgeAwaiter::execute(AsyncDS3231 &owner) {
+        next = owner.edgeWaiters;
+        owner.edgeWaiters = this;
+    }
+
+    void AsyncDS3231::ReadTimeAwaiter::execute(AsyncDS3231 &owner) {
+        result = owner.rtc.readTime(time);
+        if (result) time = {};
+        owner.resume(this);
+    }
+
+} /* namespace een1071 */
@@ -0,0 +1,156 @@
+/*
+ * AsyncDS3231.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef ASYNCDS3231_H_
+#define ASYNCDS3231_H_
+
+#include "DS3231.h"
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <time.h>
+
+namespace een1071 {
+
+    /**
+     * @brief Single-threaded executor that resumes coroutines posted from any thread. A suspended
+     * task is just its coroutine frame, so thousands of waiting tasks cost memory, not threads.
+     */
+    class RtcExecutor {
+    public:
+        void post(std::coroutine_handle<> handle);
+        void run();
+        void stop();
+
+    private:
+        std::mutex m;
+        std::condition_variable ready;
+        std::deque<std::coroutine_handle<>> queue;
+        bool stopped = false;
+    };
+
+    /**
+     * @brief Fire-and-forget coroutine. It starts suspended and runs once spawned on an executor;
+     * its frame is freed when it finishes.
+     */
+    class RtcTask {
+    public:
+        struct promise_type {
+            RtcTask get_return_object() { return RtcTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        RtcTask(RtcTask &&other) : handle(other.handle) { other.handle = nullptr; }
+        ~RtcTask() { if (handle) handle.destroy(); }
+        void spawn(RtcExecutor &executor) { executor.post(handle); handle = nullptr; }
+
+    private:
+        explicit RtcTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    class AsyncDS3231;
+
+    // A request queued to the RTC thread; lives in the awaiting coroutine's frame
+    struct RtcOperation {
+        virtual void execute(AsyncDS3231 &rtc) = 0;
+        std::coroutine_handle<> handle;
+        RtcOperation *next = nullptr;
+    };
+
+    /**
+     * @brief Awaitable front end for a DS3231:
+     *     co_await rtc.alarm(desc);   // programs the alarm, resumes when it fires
+     *     co_await rtc.nextEdge();    // resumes on the next INT/SQW falling edge, with its timestamp
+     *     co_await rtc.readTime();    // burst-reads the time without blocking the executor
+     * All bus access and the waiter lists belong to one internal RTC thread, which resumes coroutines
+     * by posting them to the executor. Edges come in through onInterrupt(), e.g. from pigpioAlert().
+     */
+    class AsyncDS3231 {
+    public:
+        AsyncDS3231(DS3231 &rtc, RtcExecutor &executor);
+        ~AsyncDS3231();
+
+        void onInterrupt(const struct timespec &when);
+        static void pigpioAlert(int gpio, int level, uint32_t tick, void *self);
+
+        struct AlarmAwaiter : RtcOperation {
+            AsyncDS3231 &rtc;
+            AlarmDescriptor descriptor;
+            long long due = 0;   // RTC time of the next match, in seconds since 1970 (RTC read as UTC)
+            int result = 0;
+            AlarmAwaiter(AsyncDS3231 &rtc, const AlarmDescriptor &d) : rtc(rtc), descriptor(d) {}
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { handle = h; rtc.submit(this); }
+            int await_resume() { return result; }   // 1 if the descriptor is invalid or the RTC can't be used
+            virtual void execute(AsyncDS3231 &rtc);
+        };
+
+        struct EdgeAwaiter : RtcOperation {
+            AsyncDS3231 &rtc;
+            struct timespec when = {};
+            EdgeAwaiter(AsyncDS3231 &rtc) : rtc(rtc) {}
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { handle = h; rtc.submit(this); }
+            struct timespec await_resume() { return when; }
+            virtual void execute(AsyncDS3231 &rtc);
+        };
+
+        struct ReadTimeAwaiter : RtcOperation {
+            AsyncDS3231 &rtc;
+            struct tm time = {};
+            int result = 0;
+            ReadTimeAwaiter(AsyncDS3231 &rtc) : rtc(rtc) {}
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { handle = h; rtc.submit(this); }
+            struct tm await_resume() { return time; }   // all zero if the read failed
+            virtual void execute(AsyncDS3231 &rtc);
+        };
+
+        /**
+         * Resume when descriptor next matches the RTC time. Any number of coroutines can wait: the
+         * chip has only two alarms, so the waiters of each are queued by due time and the alarm is
+         * programmed with the earliest one (waiters with the same due time share it). It is moved on
+         * to the next waiter as they resume and disabled when none is left.
+         */
+        AlarmAwaiter alarm(const AlarmDescriptor &descriptor) { return AlarmAwaiter(*this, descriptor); }
+        EdgeAwaiter nextEdge() { return EdgeAwaiter(*this); }
+        ReadTimeAwaiter readTime() { return ReadTimeAwaiter(*this); }
+
+    private:
+        void submit(RtcOperation *operation);
+        void run();
+        void serviceInterrupt(const struct timespec &when);
+        void resume(RtcOperation *operation);
+        int readNow(long long &now, unsigned char *status);
+        void reschedule(int index);
+
+        DS3231 &rtc;
+        RtcExecutor &executor;
+        std::mutex m;
+        std::condition_variable wake;
+        RtcOperation *pending = nullptr;      // submitted, not yet executed (LIFO, reversed on take)
+        bool interrupted = false;
+        struct timespec interruptTime = {};
+        bool stopping = false;
+
+        // Owned by the RTC thread only
+        RtcOperation *edgeWaiters = nullptr;
+        RtcOperation *alarmWaiters[2] = {};     // per hardware alarm, sorted by due time
+        bool programmed[2] = {};                // the alarm currently holds programmedAs[]
+        AlarmDescriptor programmedAs[2] = {};
+        std::thread thread;
+    };
+
+} /* namespace een1071 */
+
+#endif /* ASYNCDS3231_H_ */
@@ -0,0 +1,94 @@
+/*
+ * BasicDS3231.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef BASICDS3231_H_
+#define BASICDS3231_H_
+
+#include "DS3231.h"
+
+namespace een1071 {
+
+    /**
+     * @brief DS3231 driver with the transport as a compile-time parameter. Transport needs the
+     * write(address, data, length) / read(address, data, length) calls of I2CTransport but nothing
+     * is virtual here, so with a header-only transport (I2CBus, DS3231Sim) a whole "read, decode,
+     * convert" sequence inlines into the caller. The virtual DS3231 class is unchanged.
+     */
+    template<class Transport>
+    class BasicDS3231 {
+    public:
+        explicit BasicDS3231(Transport &transport, unsigned char address = RTC_ADDR)
+            : transport(transport), address(address) {}
+
+        Transport &getTransport() { return transport; }
+
+        // @return 1 on failure, 0 on success
+        int readRegisters(unsigned char fromAddress, unsigned char *data, unsigned int number) {
+            if (transport.write(address, &fromAddress, 1) != 1) return 1;
+            return transport.read(address, data, number) != (int)number;
+        }
+
+        // @return 1 on failure, 0 on success
+        int writeRegister(unsigned char registerAddress, unsigned char value) {
+            unsigned char buffer[2] = { registerAddress, value };
+            return transport.write(address, buffer, 2) != 2;
+        }
+
+        // @return the register value, or 1 on failure (as I2CDevice::readRegister)
+        unsigned char readRegister(unsigned char registerAddress) {
+            unsigned char value;
+            return readRegisters(registerAddress, &value, 1) ? 1 : value;
+        }
+
+        /**
+         * Burst-read the seven time registers and decode them.
+         * @return 1 on failure, 0 on success
+         */
+        int readTime(struct tm &t) {
+            unsigned char r[7];
+            if (readRegisters(RTC_SECONDS, r, 7)) return 1;
+            decodeTimeRegisters(r, t);
+            return 0;
+        }
+
+        /**
+         * Read the time and convert it to seconds since 1970-01-01 00:00:00, treating the RTC
+         * calendar time as UTC (no time zone lookup, unlike mktime()).
+         * @return the epoch seconds, or -1 on failure
+         */
+        long long readEpoch() {
+            struct tm t;
+            if (readTime(t)) return -1;
+            return epochSeconds(t);
+        }
+
+        // @return the temperature in degrees C, or -1000 on failure
+        float readTemperature() {
+            unsigned char r[2];
+            if (readRegisters(RTC_TEMP, r, 2)) return -1000.0f;
+            return (signed char)r[0] + (r[1] >> 6) * 0.25f;
+        }
+
+        // Days-from-civil conversion (proleptic Gregorian calendar)
+        static long long epochSeconds(const struct tm &t) {
+            int y = t.tm_year + 1900 - (t.tm_mon < 2);
+            int era = (y >= 0 ? y : y - 399) / 400;
+            unsigned yoe = (unsigned)(y - era * 400);
+            unsigned m = t.tm_mon + 1;
+            unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + t.tm_mday - 1;
+            unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            long long days = (long long)era * 146097 + doe - 719468;
+            return days * 86400 + t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+        }
+
+    private:
+        Transport &transport;
+        unsigned char address;
+    };
+
+} /* namespace een1071 */
+
+#endif /* BASICDS3231_H_ */
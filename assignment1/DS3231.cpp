@@ -5,6 +5,7 @@
  */
 
  #include "DS3231.h"
+ #include "Trace.h"
  #include <iostream>
  #include <unistd.h>
  #include <math.h>
@@ -16,29 +17,41 @@ using namespace std;
 
 namespace een1071 {
     int bcdToDec(unsigned char bcd) {
-        return ((bcd >> 4) * 10) + (bcd & 0x0F);
+        return fromBcd(bcd);
     }
 
     int decToBcd(int dec) {
-        return ((dec / 10) << 4) | (dec % 10);
+        return toBcd(dec);
     }
 
-    // constructor is made
-    DS3231::DS3231(unsigned int bus, unsigned int device) : I2CDevice(bus, device) {}
-    DS3231 rtc(1, RTC_ADDR);
+    // constructor is made; the bus is only opened by the first register access
+    DS3231::DS3231(unsigned int bus, unsigned int device) : I2CDevice(bus, device),
+                                                            timeSource(nullptr), timeSourceData(nullptr) {}
+
+    // Replace the host clock used by setTimeDate(), setTimeFormat() and the alarms, e.g. with
+    // I2CReplay::timeSource so a replayed session writes the same time it was recorded with
+    void DS3231::setTimeSource(TimeSourceFunc source, void *userData) {
+        timeSource = source;
+        timeSourceData = userData;
+    }
+
+    // Recorded when recording, so a replay gets the same value back
+    time_t DS3231::currentTime() {
+        time_t now = timeSource ? timeSource(timeSourceData) : time(nullptr);
+        recordTime(now);
+        return now;
+    }
 
     void DS3231::clearTimeDate() {
         const int rtcRegisters[7] = { RTC_SECONDS, RTC_MINS, RTC_DAYS, RTC_HOURS, RTC_DATE, RTC_MONTH, RTC_YEAR };
 
 
         for (int i = 0; i < 7; i++) {
-           cout << "Register 0x" << hex << rtcRegisters[i]
-                 << " before clearing: 0x" << (int)readRegister(rtcRegisters[i]) << dec << endl;
+            TRACE_I("Register 0x%x before clearing: 0x%x", rtcRegisters[i], readRegister(rtcRegisters[i]));
 
             writeRegister(rtcRegisters[i], 0x00);
 
-            cout << "Register 0x" << hex << rtcRegisters[i]
-                 << " after clearing: 0x" << (int)readRegister(rtcRegisters[i]) << dec << endl;
+            TRACE_I("Register 0x%x after clearing: 0x%x", rtcRegisters[i], readRegister(rtcRegisters[i]));
         }
     }
 
@@ -53,7 +66,7 @@ namespace een1071 {
             else hour12 = hour;                 // 1-12 -> 1-12 AM/PM
 
             // Convert to BCD
-            hourReg = decToBcd(hour12);
+            hourReg = toBcd(hour12);
             hourReg |= (1 << HOUR_MODE_BIT);  // Set 12h mode bit
 
             // Set PM bit
@@ -61,15 +74,16 @@ namespace een1071 {
                 hourReg |= (1 << AM_PM_BIT);
             }
         } else {
-            hourReg = decToBcd(hour);
+            hourReg = toBcd(hour);
         }
 
         return hourReg;
     }
 
-    void DS3231::setTimeDate() {
-        time_t timestamp = time(&timestamp);
-        struct tm *ltm = localtime(&timestamp);
+    // Sets the host time, as local time or (for the SHM refclock) as UTC
+    void DS3231::setTimeDate(bool utc) {
+        time_t timestamp = currentTime();
+        struct tm *ltm = utc ? gmtime(&timestamp) : localtime(&timestamp);
 
         unsigned char hourReg = readRegister(RTC_HOURS);
         int hour = ltm->tm_hour;  // This is in 24h format from ctime
@@ -82,13 +96,13 @@ namespace een1071 {
         // Write all components
         for (int i = 0; i < 7; i++) {
             if (i == 2) {  // Hours
-                rtc.writeRegister(RTC_HOURS, hourReg);
+                writeRegister(RTC_HOURS, hourReg);
             }
             else if (i == 3) { // Day of a week
-                rtc.writeRegister(RTC_DAYS, decToBcd(timeComponents[3] + 1));
+                writeRegister(RTC_DAYS, toBcd(timeComponents[3] + 1));
             }
             else {
-                rtc.writeRegister(rtcRegisters[i], decToBcd(timeComponents[i]));
+                writeRegister(rtcRegisters[i], toBcd(timeComponents[i]));
             }
         }
     }
@@ -99,7 +113,7 @@ namespace een1071 {
         if (!is24Hour) {
             hourReg |= (1 << HOUR_MODE_BIT);  // Set bit 6 for 12h mode
             // Current hour from ctime will determine AM/PM (bit 5)
-            time_t now = time(nullptr);
+            time_t now = currentTime();
             struct tm *ltm = localtime(&now);
             if (ltm->tm_hour >= 12) {
                 hourReg |= (1 << AM_PM_BIT);  // Set bit 5 for PM
@@ -114,9 +128,9 @@ namespace een1071 {
         int hour;
 
         if (is12Hour) {
-            hour = bcdToDec(hourReg & 0x1F);  // 0x1F mask for 12h mode
+            hour = fromBcd(hourReg & 0x1F);  // 0x1F mask for 12h mode
         } else {
-            hour = bcdToDec(hourReg & 0x3F);  // 0x3F mask for 24h mode
+            hour = fromBcd(hourReg & 0x3F);  // 0x3F mask for 24h mode
         }
 
         return hour;
@@ -134,13 +148,13 @@ namespace een1071 {
 
     void DS3231::readTimeDate() {
         int timeDateVal[7];
-        unsigned char * dataList = rtc.readRegisters(7, RTC_SECONDS);
-        if (!dataList) {
+        unsigned char dataList[7];
+        if (readRegistersInto(dataList, 7, RTC_SECONDS)) {
             perror("Sorry, no timedate data was found.\n");
             return;
         }
 
-        cout << "Hour register value: 0x" << hex << (int)dataList[2] << dec << endl;
+        TRACE_D("Hour register value: 0x%x", dataList[2]);
         bool is12Hour = dataList[2] & (1 << HOUR_MODE_BIT);
         int hour = readHourValue(dataList[2]);
 
@@ -155,7 +169,7 @@ namespace een1071 {
                     timeDateVal[i] = hour;
                 }
             } else {
-                timeDateVal[i] = bcdToDec(dataList[i]);
+                timeDateVal[i] = fromBcd(dataList[i]);
             }
         }
 
@@ -170,11 +184,19 @@ namespace een1071 {
         printf("\n");
     }
 
+    // Burst-reads and decodes the time without printing it. Returns 1 on failure, 0 on success
+    int DS3231::readTime(struct tm &t) {
+        unsigned char dataList[7];
+        if (readRegistersInto(dataList, 7, RTC_SECONDS)) return 1;
+        decodeTimeRegisters(dataList, t);
+        return 0;
+    }
+
     void DS3231::readTemperature() {
         // Reads a whole number from 0x11 (start) and finishes at 0x12 (a fractional part -> 2 bytes)
-        unsigned char * tempList = rtc.readRegisters(2, RTC_TEMP);
+        unsigned char tempList[2];
 
-        if (!tempList) {
+        if (readRegistersInto(tempList, 2, RTC_TEMP)) {
             perror("Error: Failed to read temperature registers!\n");
             return;
         }
@@ -184,43 +206,107 @@ namespace een1071 {
         float fractionalPart = (tempList[1] >> 6) * 0.25;  // Extract top 2 bits, multiply by 0.25
         float temperature = wholePart + fractionalPart;
 
-        cout << "Temperature: " << temperature << "C" << endl;
+        cout << "Temperature: " << temperature << "C\n";
     }
 
-    /* TODO: add implementation for user to set an alarm time */
-    // This alarm will be triggered when seconds, mins, hours and day (current day of week) are matched! */
-    void DS3231::setAlarmOne() {
-        time_t timestamp = time(&timestamp);
-        struct tm *ltm = localtime(&timestamp);
-        unsigned char statusBefore = readRegister(STATUS_REG);
-        unsigned char hourReg = readRegister(RTC_HOURS);
-        bool is12Hour = hourReg & (1 << HOUR_MODE_BIT);
-
-        // Add 1 minute to current time
-        int minutes = ltm->tm_min + 1;
-        if(minutes >= 60) {
-            minutes = 0;
-            ltm->tm_hour++;
+    // Fills the alarm's registers (4 for alarm 1 from ALARM1_REG_SECONDS, 3 for alarm 2 from
+    // ALARM2_REG_MINUTES) and returns how many, or -1 if the descriptor is invalid
+    int DS3231::encodeAlarm(const AlarmDescriptor &alarm, unsigned char *regs) {
+        int fields = alarm.alarm == 1 ? 4 : 3;
+        int matched;  // fields compared, counting up from the seconds (alarm 1) or minutes (alarm 2)
+
+        if (alarm.alarm != 1 && alarm.alarm != 2) return -1;
+        switch (alarm.rate) {
+        case ALARM_EVERY_SECOND: if (alarm.alarm != 1) return -1; matched = 0; break;
+        case ALARM_EVERY_MINUTE: if (alarm.alarm != 2) return -1; matched = 0; break;
+        case ALARM_MATCH_SECONDS: if (alarm.alarm != 1) return -1; matched = 1; break;
+        case ALARM_MATCH_MINUTES: matched = fields - 2; break;
+        case ALARM_MATCH_HOURS: matched = fields - 1; break;
+        case ALARM_MATCH_DATE:
+        case ALARM_MATCH_DAY: matched = fields; break;
+        default: return -1;
         }
 
-        // Clear alarms status before setting new alarm
-        writeRegister(STATUS_REG, statusBefore & ~0x03);
+        bool isDay = alarm.rate == ALARM_MATCH_DAY;
+        if (alarm.second < 0 || alarm.second > 59 || alarm.minute < 0 || alarm.minute > 59
+                || alarm.hour < 0 || alarm.hour > 23) return -1;
+        if (matched == fields && (alarm.dayOrDate < 1 || alarm.dayOrDate > (isDay ? 7 : 31))) return -1;
 
-        // Set alarm registers
-        writeRegister(ALARM1_REG_SECONDS, decToBcd(ltm->tm_sec) & 0x7F);  // A1M1 = 0
-        writeRegister(ALARM1_REG_MINUTES, decToBcd(minutes) & 0x7F);      // A1M2 = 0
+        int i = 0;
+        if (alarm.alarm == 1) regs[i++] = toBcd(alarm.second);
+        regs[i++] = toBcd(alarm.minute);
+        regs[i++] = checkIf12HFormat(alarm.twelveHour ? (1 << HOUR_MODE_BIT) : 0, alarm.hour);
+        regs[i++] = toBcd(alarm.dayOrDate > 0 ? alarm.dayOrDate : 1) | (isDay ? (1 << ALARM_DYDT_BIT) : 0);
 
-        if(is12Hour) {
-            unsigned char alarmHourReg = checkIf12HFormat(hourReg, ltm->tm_hour);
-            writeRegister(ALARM1_REG_HOURS, alarmHourReg & 0x7F);   // A1M3 = 0; bit 6 is 1 and bit 5 is 0/1 depending on am/pm
-        } else {
-            writeRegister(ALARM1_REG_HOURS, decToBcd(ltm->tm_hour) & 0x7F);   // A1M3 = 0
+        // AxMy = 1 on every field that is not compared
+        for (i = matched; i < fields; i++) regs[i] |= (1 << ALARM_MASK_BIT);
+        return fields;
+    }
+
+    /**
+     * Programs one alarm and enables its interrupt. The registers 0x07-0x0F are read in one block,
+     * the alarm's flag is cleared, then the whole alarm block plus CONTROL_REG (0x07-0x0E) goes out
+     * in one burst write and is read back to verify it. The other alarm and the unrelated control bits
+     * are written back unchanged.
+     * @return 1 on an invalid descriptor, bus failure or read-back mismatch, 0 on success.
+     */
+    int DS3231::programAlarm(const AlarmDescriptor &alarm) {
+        const int block = CONTROL_REG - ALARM1_REG_SECONDS + 1;
+        unsigned char regs[block + 1];  // + STATUS_REG
+        unsigned char readBack[block];
+        unsigned char fields[4];
+
+        int count = encodeAlarm(alarm, fields);
+        if (count < 0) {
+            TRACE_E("Invalid descriptor for alarm %d (rate %d)", alarm.alarm, alarm.rate);
+            return 1;
         }
+        if (readRegistersInto(regs, block + 1, ALARM1_REG_SECONDS)) return 1;
+
+        int offset = (alarm.alarm == 1 ? ALARM1_REG_SECONDS : ALARM2_REG_MINUTES) - ALARM1_REG_SECONDS;
+        for (int i = 0; i < count; i++) regs[offset + i] = fields[i];
+        // CONV is not written back: a 1 read mid-conversion would start another one
+        const int control = CONTROL_REG - ALARM1_REG_SECONDS;
+        regs[control] |= CONTROL_INTCN | (alarm.alarm == 1 ? CONTROL_A1IE : CONTROL_A2IE);
+        regs[control] &= ~CONTROL_CONV;
+
+        if (writeRegisters(ALARM1_REG_SECONDS, regs, block)) return 1;
+        if (readRegistersInto(readBack, block, ALARM1_REG_SECONDS)) return 1;
+        // The chip may be converting on its own schedule, so CONV can read back as 1
+        readBack[control] &= ~CONTROL_CONV;
+        for (int i = 0; i < block; i++) {
+            if (readBack[i] != regs[i]) {
+                TRACE_E("Alarm %d verify failed at register 0x%x: wrote 0x%x, read 0x%x",
+                        alarm.alarm, ALARM1_REG_SECONDS + i, regs[i], readBack[i]);
+                return 1;
+            }
+        }
+
+        // Cleared only now: the old setting could still match before the burst write and leave the
+        // flag set, so the new alarm would look fired at once. Alarm flags can only be written to 0,
+        // so writing 1 leaves the other alarm's flag as it is
+        unsigned char status = regs[block] | STATUS_A1F | STATUS_A2F;
+        status &= ~(alarm.alarm == 1 ? STATUS_A1F : STATUS_A2F);
+        return writeRegister(STATUS_REG, status);
+    }
+
+    // Returns the local time one minute from now and whether the RTC is in 12h mode
+    static bool alarmInOneMinute(DS3231 &rtc, struct tm &when) {
+        time_t timestamp = rtc.currentTime();
+        localtime_r(&timestamp, &when);
+        when.tm_min += 1;
+        mktime(&when);  // carries into the hour, day, month...
+        return rtc.readRegister(RTC_HOURS) & (1 << HOUR_MODE_BIT);
+    }
+
+    // This alarm will be triggered when seconds, mins, hours and day (current day of week) are matched! */
+    void DS3231::setAlarmOne() {
+        struct tm when;
+        bool is12Hour = alarmInOneMinute(*this, when);
 
-        // Day alarm (RTC starts at 0 == Sunday; bit DYDT is set to 1, but A1M4 is 0 to indicate usage of date/day field)
-        writeRegister(ALARM1_REG_DAY, 0x40 | decToBcd(ltm->tm_wday + 1));
-        // Enable Alarm 1 interrupt
-        writeRegister(CONTROL_REG, 0x05);  // Set INTCN and A1|E
+        // RTC starts at 1 == Sunday, ctime at 0
+        AlarmDescriptor alarm = { 1, ALARM_MATCH_DAY, when.tm_sec, when.tm_min, when.tm_hour, when.tm_wday + 1, is12Hour };
+        programAlarm(alarm);
         readAlarmOne();
     }
 
@@ -233,54 +319,30 @@ namespace een1071 {
 
         if (is12Hour) {
             bool isPM = hour & (1 << 5);
-            int hour12 = bcdToDec(hour & 0x1F);
+            int hour12 = fromBcd(hour & 0x1F);
 
             cout << "Alarm 1 is set for: "
                  << hour12 << ":"
-                 << bcdToDec(min & 0x7F) << ":"
-                 << bcdToDec(sec & 0x7F) << " "
+                 << fromBcd(min & 0x7F) << ":"
+                 << fromBcd(sec & 0x7F) << " "
                  << (isPM ? "PM" : "AM");
         } else {
             cout << "Alarm 1 is set for: "
-                 << bcdToDec(hour & 0x7F) << ":"
-                 << bcdToDec(min & 0x7F) << ":"
-                 << bcdToDec(sec & 0x7F);
+                 << fromBcd(hour & 0x7F) << ":"
+                 << fromBcd(min & 0x7F) << ":"
+                 << fromBcd(sec & 0x7F);
         }
 
-        cout << " on day " << getDayOfWeek(bcdToDec(day & 0x3F)) << endl;
+        cout << " on day " << getDayOfWeek(fromBcd(day & 0x3F)) << "\n";
     }
 
     // This alarm will be triggered when mins, hours and date (today) are matched! */
     void DS3231::setAlarmTwo() {
-        time_t timestamp = time(&timestamp);
-        struct tm *ltm = localtime(&timestamp);
-        unsigned char statusBefore = readRegister(STATUS_REG);
-        unsigned char hourReg = readRegister(RTC_HOURS);
-        bool is12Hour = hourReg & (1 << HOUR_MODE_BIT);
-
-        // Add 1 minute to current time
-        int minutes = ltm->tm_min + 1;
-        if(minutes >= 60) {
-            minutes = 0;
-            ltm->tm_hour++;
-        }
-
-        // Clear alarms status before setting new alarm
-        writeRegister(STATUS_REG, statusBefore & ~0x03);
+        struct tm when;
+        bool is12Hour = alarmInOneMinute(*this, when);
 
-        // Set alarm registers
-        writeRegister(ALARM2_REG_MINUTES, decToBcd(minutes) & 0x7F); // A2M2 = 0
-
-        if(is12Hour) {
-            unsigned char alarmHourReg = checkIf12HFormat(hourReg, ltm->tm_hour);
-            writeRegister(ALARM2_REG_HOURS, alarmHourReg & 0x7F);   // A2M3 = 0; bit 6 is 1 and bit 5 is 0/1 depending on am/pm
-        } else {
-            writeRegister(ALARM2_REG_HOURS, decToBcd(ltm->tm_hour) & 0x7F);   // A2M3 = 0
-        }
-
-        writeRegister(ALARM2_REG_DAY, decToBcd(ltm->tm_mday) & 0x3F);
-        // Enable Alarm 2 interrupt
-        writeRegister(CONTROL_REG, 0x06);  // Set INTCN and A2|E
+        AlarmDescriptor alarm = { 2, ALARM_MATCH_DATE, 0, when.tm_min, when.tm_hour, when.tm_mday, is12Hour };
+        programAlarm(alarm);
         readAlarmTwo();
     }
 
@@ -294,26 +356,26 @@ namespace een1071 {
 
         if (is12Hour) {
             bool isPM = hour & (1 << 5);
-            int hour12 = bcdToDec(hour & 0x1F);
+            int hour12 = fromBcd(hour & 0x1F);
 
             cout << "Alarm 2 is set for: "
                  << hour12 << ":"
-                 << bcdToDec(min & 0x7F) << ":"
+                 << fromBcd(min & 0x7F) << ":"
                  << (isPM ? "PM" : "AM");
         } else {
             cout << "Alarm 2 is set for: "
-                 << bcdToDec(hour & 0x7F) << ":"
-                 << bcdToDec(min & 0x7F);
+                 << fromBcd(hour & 0x7F) << ":"
+                 << fromBcd(min & 0x7F);
         }
 
-        cout << " on date " << getMonth(bcdToDec(month & 0x1F) -1) << ", " << bcdToDec(date & 0x3F) << endl;
+        cout << " on date " << getMonth(fromBcd(month & 0x1F) -1) << ", " << fromBcd(date & 0x3F) << "\n";
     }
 
     void DS3231::triggerLED() {
         unsigned char status = readRegister(STATUS_REG);
 
         if (status & 0x01) {
-            cout << "Yay, alarm 1 is triggered and LED is on!" << endl;
+            TRACE_I("Yay, alarm 1 is triggered and LED is on!");
             gpioWrite(LED_PIN, 1);
             gpioDelay(1000000);
             gpioWrite(LED_PIN, 0);
@@ -322,7 +384,7 @@ namespace een1071 {
         }
 
         if (status & 0x02) {
-            cout << "Yay, alarm 2 triggered and LED is on!" << endl;
+            TRACE_I("Yay, alarm 2 triggered and LED is on!");
             gpioWrite(LED_PIN, 1);
             gpioDelay(1000000);
             gpioWrite(LED_PIN, 0);
@@ -331,61 +393,75 @@ namespace een1071 {
         }
     }
 
-    bool DS3231::sqwStatusCheck(unsigned char expectedVal, string success, string failure) {
+    // Reads CONTROL_REG back; the callers trace the outcome with their own messages
+    bool DS3231::sqwStatusCheck(unsigned char expectedVal) {
         unsigned char endVal = readRegister(CONTROL_REG);
 
         if (endVal == expectedVal) {
-            cout << success << endl;
             return true;
         }
         else {
-            cout << failure << endl;
+            TRACE_I("SQW is failed... (control register 0x%x, expected 0x%x)", endVal, expectedVal);
             return false;
         }
     }
 
-    void DS3231::enableSQW(int frequency) {
-        unsigned char control = readRegister(CONTROL_REG);
-        writeRegister(STATUS_REG, 0x00);  // Clear ALL flags
-        cout << "Initial Control Register: 0x" << hex << (int)control << dec << endl;
-
-        if (!control) {
-            perror("Can't read control register.");
-            return;
+    // Returns the CONTROL_REG value that outputs the given SQW frequency (0 switches back to
+    // interrupt mode), keeping every other bit of `control`, or -1 for an unsupported frequency
+    int DS3231::encodeSQW(unsigned char control, int frequency) {
+        if (frequency == 0) {
+            return control | 0x04;  // INTCN = 1
         }
 
-        // Clear INTCN bit to enable SQW
+        // Clear INTCN bit to enable SQW, then clear RS1 and RS2 bits
         control &= ~0x04;
-
-        // Clear RS1 and RS2 bits
         control &= ~0x18;
 
         switch(frequency) {
         case 1: // 1 Hz => RS1 = 0; RS2 = 0
-            cout << "Setting 1Hz..." << endl;
             break;
         case 1024: // 1024kHz => RS1 = 1; RS2 = 0
             control |= 0x8;
-            cout << "Setting 1.024 kHz (RS1 = 1, RS2 = 0)" << endl;
             break;
         case 4096: // 4096kHz => RS1 = 0; RS2 = 1
-             control |= 0x10;
-             cout << "Setting 4.096 kHz (RS1 = 0, RS2 = 1)" << endl;
+            control |= 0x10;
             break;
         case 8192: // 8192kHz => RS1 = 1; RS2 = 1
-             control |= 0x18;
-             cout << "Setting 8.192 kHz (RS1 = 1, RS2 = 1)" << endl;
+            control |= 0x18;
             break;
         default:
-            cout << "Invalid" << endl;
-            break;
+            return -1;
+        }
+        return control;
+    }
+
+    void DS3231::enableSQW(int frequency) {
+        unsigned char control = readRegister(CONTROL_REG);
+        writeRegister(STATUS_REG, 0x00);  // Clear ALL flags
+        TRACE_D("Initial Control Register: 0x%x", control);
+
+        if (!control) {
+            perror("Can't read control register.");
+            return;
         }
 
+        int encoded = encodeSQW(control, frequency);
+        if (encoded < 0) {
+            TRACE_E("Invalid SQW frequency %d", frequency);
+            return;
+        }
+        control = encoded;
+        TRACE_I("Setting %d Hz (RS1 = %d, RS2 = %d)", frequency, (control >> 3) & 1, (control >> 4) & 1);
+
         writeRegister(CONTROL_REG, control);
-        unsigned char test = readRegister(CONTROL_REG);
-        cout << "Control Register after writing: 0x" << hex << (int)test << dec << endl;
+        TRACE_D("Control Register after writing: 0x%x", readRegister(CONTROL_REG));
+
+        if (sqwStatusCheck(control)) TRACE_I("SQW enabled at %d Hz", frequency);
+    }
 
-        sqwStatusCheck(control, "SQW enabled at " + to_string(frequency) + " kHz", "SQW is failed...");
+    // The DS3231 only has registers 0x00-0x12, where I2CDevice::debugDumpRegisters() defaults to 0xff
+    void DS3231::dumpRegisters() {
+        debugDumpRegisters(DS3231_REG_COUNT);
     }
 
     void DS3231::disableSQW() {
@@ -401,7 +477,7 @@ namespace een1071 {
         control |= 0x4;
 
         writeRegister(CONTROL_REG, control);
-        sqwStatusCheck(control, "SQW disabled, set to interrupt mode", "SQW is failed...");
+        if (sqwStatusCheck(control)) TRACE_I("SQW disabled, set to interrupt mode");
     }
 }
 
@@ -9,6 +9,7 @@
 
 #include"I2CDevice.h"
 #include <string>
+#include <time.h>
 
 #define RTC_ADDR 0x68
 
@@ -24,6 +25,7 @@
 #define AM_PM_BIT 5
 
 #define RTC_TEMP 0x11
+#define DS3231_REG_COUNT 0x13   // registers 0x00-0x12
 
 #define ALARM1_REG_SECONDS 0x07
 #define ALARM1_REG_MINUTES 0x08
@@ -39,16 +41,87 @@
 #define STATUS_REG 0x0F
 #define CONTROL_REG 0x0E
 
+#define ALARM_MASK_BIT 7   // AxMy bits: 1 = ignore this field when matching
+#define ALARM_DYDT_BIT 6   // 1 = match day of week, 0 = match date
+
+#define CONTROL_INTCN 0x04
+#define CONTROL_A1IE 0x01
+#define CONTROL_A2IE 0x02
+#define CONTROL_CONV 0x20   // starts a temperature conversion, cleared by the chip when it is done
+#define STATUS_A1F 0x01
+#define STATUS_A2F 0x02
+#define STATUS_OSF 0x80
+
 #define INT_SQW_PIN 17
 #define LED_PIN 18
 
 namespace een1071 {
+    // Alarm rates from the datasheet's mask bit table. EVERY_SECOND is alarm 1 only and
+    // EVERY_MINUTE (at 00 seconds) is alarm 2 only; alarm 2 has no seconds to match.
+    enum AlarmRate {
+        ALARM_EVERY_SECOND,
+        ALARM_EVERY_MINUTE,
+        ALARM_MATCH_SECONDS,   // seconds
+        ALARM_MATCH_MINUTES,   // minutes (and seconds for alarm 1)
+        ALARM_MATCH_HOURS,     // hours, minutes (and seconds)
+        ALARM_MATCH_DATE,      // date of the month, hours, minutes (and seconds)
+        ALARM_MATCH_DAY        // day of the week, hours, minutes (and seconds)
+    };
+
+    struct AlarmDescriptor {
+        int alarm;          // 1 or 2
+        AlarmRate rate;
+        int second;
+        int minute;
+        int hour;           // always 0-23, converted when twelveHour is set
+        int dayOrDate;      // 1-7 (Sunday = 1) for ALARM_MATCH_DAY, 1-31 for ALARM_MATCH_DATE
+        bool twelveHour;    // store the hour in 12h format with the AM/PM bit
+    };
+
     int bcdToDec(unsigned char);
     int decToBcd(int);
 
+    // Inline versions of the above, so that the templated BasicDS3231 can fold them into its register decoding
+    inline int fromBcd(unsigned char bcd) {
+        return ((bcd >> 4) * 10) + (bcd & 0x0F);
+    }
+
+    inline int toBcd(int dec) {
+        return ((dec / 10) << 4) | (dec % 10);
+    }
+
+    // Converts an hours register in either 12h or 24h mode to 0-23
+    inline int decodeHourRegister(unsigned char hourReg) {
+        if (hourReg & (1 << HOUR_MODE_BIT)) {
+            int hour12 = fromBcd(hourReg & 0x1F) % 12;
+            return (hourReg & (1 << AM_PM_BIT)) ? hour12 + 12 : hour12;
+        }
+        return fromBcd(hourReg & 0x3F);
+    }
+
+    // Decodes the seven registers from RTC_SECONDS to RTC_YEAR; tm_isdst is left to mktime()
+    inline void decodeTimeRegisters(const unsigned char *r, struct tm &t) {
+        t.tm_sec = fromBcd(r[0] & 0x7F);
+        t.tm_min = fromBcd(r[1] & 0x7F);
+        t.tm_hour = decodeHourRegister(r[2]);
+        t.tm_wday = fromBcd(r[3] & 0x07) - 1;   // setTimeDate() stores Sunday as 1
+        t.tm_mday = fromBcd(r[4] & 0x3F);
+        t.tm_mon = fromBcd(r[5] & 0x1F) - 1;
+        t.tm_year = 100 + fromBcd(r[6]) + ((r[5] & 0x80) ? 100 : 0);  // century bit
+        t.tm_yday = 0;
+        t.tm_isdst = -1;
+    }
+
+    typedef time_t (*TimeSourceFunc)(void *userData);
+
     class DS3231:public I2CDevice{
+    private:
+        TimeSourceFunc timeSource;
+        void *timeSourceData;
     public:
         DS3231(unsigned int bus, unsigned int device);
+        void setTimeSource(TimeSourceFunc, void*);
+        time_t currentTime();
         void clearTimeDate();
         std::string getDayOfWeek(int);
         std::string getMonth(int);
@@ -58,11 +131,15 @@ namespace een1071 {
         int readHourValue(unsigned char);
 
         void setAMPM(bool isPM);
-        void setTimeDate();
+        void setTimeDate(bool utc = false);
 
         void readRegisterYear();
         void readTemperature();
         void readTimeDate();
+        int readTime(struct tm&);
+
+        int encodeAlarm(const AlarmDescriptor&, unsigned char*);
+        int programAlarm(const AlarmDescriptor&);
 
         void setAlarmOne();
         void readAlarmOne();
@@ -72,10 +149,13 @@ namespace een1071 {
 
         void triggerLED();
 
+        static int encodeSQW(unsigned char, int);
         void enableSQW(int);
         void disableSQW();
 
-        bool sqwStatusCheck(unsigned char, std::string, std::string);
+        bool sqwStatusCheck(unsigned char);
+
+        void dumpRegisters();
     };
 
 } /* namespace een1071 */
@@ -0,0 +1,88 @@
+/*
+ * DS3231Sim.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "DS3231Sim.h"
+#include <string.h>
+#include <time.h>
+
+namespace een1071 {
+
+DS3231Sim::DS3231Sim() {
+	this->reset();
+}
+
+/**
+ * Put the registers into their power-on state: time and alarms cleared, INTCN, RS2 and RS1 set
+ * in the control register and the oscillator stop flag set in the status register.
+ */
+void DS3231Sim::reset(){
+	memset(this->registers, 0, sizeof(this->registers));
+	this->registers[CONTROL_REG] = 0x1C;
+	this->registers[STATUS_REG] = 0x88;
+	this->pointer = 0;
+}
+
+/**
+ * True when the alarm whose registers start at regs matches t. Fields with their AxMy bit set
+ * are not compared; alarm 2 has no seconds register and matches at 00 seconds.
+ */
+static bool alarmMatches(const unsigned char *regs, bool hasSeconds, const struct tm &t){
+	const unsigned char mask = 1 << ALARM_MASK_BIT;
+	if(hasSeconds){
+		if(!(regs[0] & mask) && fromBcd(regs[0] & 0x7F) != t.tm_sec) return false;
+		regs++;
+	} else if(t.tm_sec != 0) return false;
+	if(!(regs[0] & mask) && fromBcd(regs[0] & 0x7F) != t.tm_min) return false;
+	if(!(regs[1] & mask) && decodeHourRegister(regs[1] & 0x7F) != t.tm_hour) return false;
+	if(!(regs[2] & mask)){
+		if(regs[2] & (1 << ALARM_DYDT_BIT)) return (regs[2] & 0x0F) == t.tm_wday + 1;
+		return fromBcd(regs[2] & 0x3F) == t.tm_mday;
+	}
+	return true;
+}
+
+/**
+ * Advance the time registers by one second, carrying into minutes, hours, day, date, month and
+ * year like the chip's oscillator does. The 12h/24h mode of the hours register is kept. An alarm
+ * that matches the new time sets its flag.
+ */
+void DS3231Sim::tick(){
+	struct tm t;
+	decodeTimeRegisters(this->registers, t);
+	t.tm_sec += 1;
+	time_t next = timegm(&t);
+	gmtime_r(&next, &t);
+
+	bool is12Hour = this->registers[RTC_HOURS] & (1 << HOUR_MODE_BIT);
+	int century = t.tm_year >= 200 ? 0x80 : 0;
+	this->registers[RTC_SECONDS] = toBcd(t.tm_sec);
+	this->registers[RTC_MINS] = toBcd(t.tm_min);
+	if(is12Hour){
+		int hour12 = t.tm_hour % 12 == 0 ? 12 : t.tm_hour % 12;
+		this->registers[RTC_HOURS] = toBcd(hour12) | (1 << HOUR_MODE_BIT) | (t.tm_hour >= 12 ? (1 << AM_PM_BIT) : 0);
+	} else {
+		this->registers[RTC_HOURS] = toBcd(t.tm_hour);
+	}
+	this->registers[RTC_DAYS] = t.tm_wday + 1;
+	this->registers[RTC_DATE] = toBcd(t.tm_mday);
+	this->registers[RTC_MONTH] = toBcd(t.tm_mon + 1) | century;
+	this->registers[RTC_YEAR] = toBcd(t.tm_year % 100);
+
+	if(alarmMatches(&this->registers[ALARM1_REG_SECONDS], true, t)) this->registers[STATUS_REG] |= STATUS_A1F;
+	if(alarmMatches(&this->registers[ALARM2_REG_MINUTES], false, t)) this->registers[STATUS_REG] |= STATUS_A2F;
+}
+
+/**
+ * The INT/SQW pin level the chip would drive: low (true) while INTCN is set and an alarm flag is
+ * set with its interrupt enabled (AxF and AxIE have the same bit positions).
+ */
+bool DS3231Sim::interruptAsserted() const{
+	unsigned char control = this->registers[CONTROL_REG];
+	unsigned char status = this->registers[STATUS_REG];
+	return (control & CONTROL_INTCN) && (status & control & (STATUS_A1F | STATUS_A2F));
+}
+
+} /* namespace een1071 */
@@ -0,0 +1,62 @@
+/*
+ * DS3231Sim.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef DS3231SIM_H_
+#define DS3231SIM_H_
+
+#include "I2CTransport.h"
+#include "DS3231.h"
+
+namespace een1071 {
+
+/**
+ * @class DS3231Sim
+ * @brief Memory-backed DS3231 register file that can stand in for the bus (see
+ * I2CDevice::setTransport()) when testing without hardware. Like the real chip, a write sets the
+ * register pointer from its first byte and both reads and writes auto-increment it, wrapping
+ * from 0x12 back to 0x00. Only the device at RTC_ADDR acknowledges. The OSF, A2F and A1F flags can
+ * only be written to 0, and tick() sets A1F/A2F when an alarm matches.
+ */
+class DS3231Sim final:public I2CTransport{
+private:
+	unsigned char pointer;
+public:
+	unsigned char registers[DS3231_REG_COUNT];
+
+	DS3231Sim();
+	void reset();
+	void tick();
+	bool interruptAsserted() const;
+	// Defined inline (and the class is final) so BasicDS3231<DS3231Sim> can inline whole transactions
+	virtual int write(unsigned char address, const unsigned char *data, unsigned int length){
+		if(address != RTC_ADDR) return -1;
+		if(length == 0) return 0;
+		this->pointer = data[0] % DS3231_REG_COUNT;
+		for(unsigned int i=1; i<length; i++){
+			unsigned char value = data[i];
+			if(this->pointer == STATUS_REG){
+				const unsigned char flags = STATUS_OSF | STATUS_A2F | STATUS_A1F;
+				value = (value & ~flags) | (value & this->registers[STATUS_REG] & flags);
+			}
+			this->registers[this->pointer] = value;
+			this->pointer = (this->pointer + 1) % DS3231_REG_COUNT;
+		}
+		return length;
+	}
+
+	virtual int read(unsigned char address, unsigned char *data, unsigned int length){
+		if(address != RTC_ADDR) return -1;
+		for(unsigned int i=0; i<length; i++){
+			data[i] = this->registers[this->pointer];
+			this->pointer = (this->pointer + 1) % DS3231_REG_COUNT;
+		}
+		return length;
+	}
+};
+
+} /* namespace een1071 */
+
+#endif /* DS3231SIM_H_ */
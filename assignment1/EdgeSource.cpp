@@ -0,0 +1,81 @@
+/*
+ * EdgeSource.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "EdgeSource.h"
+#include <errno.h>
+#include <pigpio.h>
+
+using namespace std;
+
+namespace een1071 {
+
+    static void addNs(struct timespec &t, long long ns) {
+        long long total = t.tv_nsec + ns;
+        t.tv_sec += total / 1000000000LL;
+        t.tv_nsec = total % 1000000000LL;
+        if (t.tv_nsec < 0) {
+            t.tv_nsec += 1000000000L;
+            t.tv_sec--;
+        }
+    }
+
+    void tickToRealtime(uint32_t tick, struct timespec &when) {
+        clock_gettime(CLOCK_REALTIME, &when);
+        uint32_t age = gpioTick() - tick;  // wraps correctly in unsigned arithmetic
+        addNs(when, -(long long)age * 1000);
+    }
+
+    GpioEdgeSource::GpioEdgeSource(unsigned int pin) : pin(pin), last(), count(0), taken(0) {
+        gpioSetMode(pin, PI_INPUT);
+        gpioSetPullUpDown(pin, PI_PUD_UP);  // INT/SQW is open drain
+        gpioSetAlertFuncEx(pin, alert, this);
+    }
+
+    GpioEdgeSource::~GpioEdgeSource() {
+        gpioSetAlertFuncEx(pin, NULL, NULL);
+    }
+
+    void GpioEdgeSource::alert(int, int level, uint32_t tick, void *userData) {
+        if (level != 0) return;  // falling edges only
+        GpioEdgeSource *self = (GpioEdgeSource*)userData;
+
+        struct timespec now;
+        tickToRealtime(tick, now);
+
+        lock_guard<mutex> lock(self->m);
+        self->last = now;
+        self->count++;
+        self->edge.notify_one();
+    }
+
+    int GpioEdgeSource::waitEdge(struct timespec &when, int timeoutMs) {
+        unique_lock<mutex> lock(m);
+        if (!edge.wait_for(lock, chrono::milliseconds(timeoutMs), [&] { return count != taken; })) return 1;
+        taken = count;  // only the latest edge matters, missed ones are skipped
+        when = last;
+        return 0;
+    }
+
+    SimEdgeSource::SimEdgeSource(DS3231Sim &sim) : sim(sim) {}
+
+    int SimEdgeSource::waitEdge(struct timespec &when, int timeoutMs) {
+        struct timespec now, due;
+        clock_gettime(CLOCK_REALTIME, &now);
+        due.tv_sec = now.tv_sec + 1;
+        due.tv_nsec = 0;
+        struct timespec limit = now;
+        addNs(limit, (long long)timeoutMs * 1000000);
+        if (limit.tv_sec < due.tv_sec) {
+            while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &limit, NULL) == EINTR) {}
+            return 1;
+        }
+        while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &due, NULL) == EINTR) {}
+        sim.tick();
+        clock_gettime(CLOCK_REALTIME, &when);
+        return 0;
+    }
+
+} /* namespace een1071 */
@@ -0,0 +1,70 @@
+/*
+ * EdgeSource.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef EDGESOURCE_H_
+#define EDGESOURCE_H_
+
+#include "DS3231Sim.h"
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <time.h>
+
+namespace een1071 {
+
+    // Host CLOCK_REALTIME time of a pigpio tick, i.e. of the level change rather than of the callback
+    void tickToRealtime(uint32_t tick, struct timespec &when);
+
+    /**
+     * @brief Source of INT/SQW falling edges, each stamped with the host CLOCK_REALTIME time at which
+     * it happened.
+     */
+    class EdgeSource {
+    public:
+        // Blocks until the next edge or the timeout. Returns 1 on timeout, 0 on an edge
+        virtual int waitEdge(struct timespec &when, int timeoutMs) = 0;
+        virtual ~EdgeSource() {}
+    };
+
+    /**
+     * @brief Edges on a GPIO pin via a pigpio alert. pigpio reports the tick (in us) at which it
+     * sampled the level change; the callback converts it to CLOCK_REALTIME, so the latency of
+     * pigpio's alert thread doesn't end up in the timestamp. Needs gpioInitialise() first.
+     */
+    class GpioEdgeSource:public EdgeSource {
+    public:
+        GpioEdgeSource(unsigned int pin = INT_SQW_PIN);
+        ~GpioEdgeSource();
+        virtual int waitEdge(struct timespec &when, int timeoutMs);
+
+    private:
+        static void alert(int gpio, int level, uint32_t tick, void *userData);
+
+        unsigned int pin;
+        std::mutex m;
+        std::condition_variable edge;
+        struct timespec last;
+        unsigned long count;
+        unsigned long taken;
+    };
+
+    /**
+     * @brief Simulated 1 Hz SQW for running without hardware: wakes on each whole CLOCK_REALTIME
+     * second with an absolute clock_nanosleep and ticks a DS3231Sim, like the chip's seconds
+     * counter rolls over on the falling edge.
+     */
+    class SimEdgeSource:public EdgeSource {
+    public:
+        SimEdgeSource(DS3231Sim &sim);
+        virtual int waitEdge(struct timespec &when, int timeoutMs);
+
+    private:
+        DS3231Sim &sim;
+    };
+
+} /* namespace een1071 */
+
+#endif /* EDGESOURCE_H_ */
@@ -0,0 +1,56 @@
+/*
+ * I2CBus.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef I2CBUS_H_
+#define I2CBUS_H_
+
+#include "I2CDevice.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+namespace een1071 {
+
+/**
+ * @class I2CBus
+ * @brief Non-virtual /dev/i2c-N transport for the statically dispatched BasicDS3231. It offers the
+ * same write/read calls as I2CTransport, opens the bus on first use and only issues I2C_SLAVE when
+ * the target address changes.
+ */
+class I2CBus{
+private:
+	unsigned int bus;
+	int file;
+	int selected;
+
+	int select(unsigned char address){
+		if(this->file < 0 && (this->file = ::open(this->bus == 0 ? I2C_0 : I2C_1, O_RDWR)) < 0) return 1;
+		if(this->selected == address) return 0;
+		if(ioctl(this->file, I2C_SLAVE, address) < 0) return 1;
+		this->selected = address;
+		return 0;
+	}
+public:
+	explicit I2CBus(unsigned int bus) : bus(bus), file(-1), selected(-1) {}
+	I2CBus(const I2CBus&) = delete;
+	I2CBus& operator=(const I2CBus&) = delete;
+	~I2CBus() { if(this->file >= 0) ::close(this->file); }
+
+	int write(unsigned char address, const unsigned char *data, unsigned int length){
+		if(this->select(address)) return -1;
+		return ::write(this->file, data, length);
+	}
+
+	int read(unsigned char address, unsigned char *data, unsigned int length){
+		if(this->select(address)) return -1;
+		return ::read(this->file, data, length);
+	}
+};
+
+} /* namespace een1071 */
+
+#endif /* I2CBUS_H_ */
@@ -4,51 +4,60 @@
  */
 
 #include"I2CDevice.h"
-#include<iostream>
-#include<sstream>
+#include"I2CReplay.h"
 #include<fcntl.h>
 #include<stdio.h>
-#include<iomanip>
 #include<unistd.h>
 #include<sys/ioctl.h>
 #include<linux/i2c.h>
 #include<linux/i2c-dev.h>
 using namespace std;
 
-#define HEX(x) setw(2) << setfill('0') << hex << (int)(x)
-
 namespace een1071 {
 
 /**
  * Constructor for the I2CDevice class. It requires the bus number and device number. The constructor
- * opens a file handle to the I2C device, which is destroyed when the destructor is called
+ * only stores them: the bus is opened on the first transfer (or an explicit open()) and the file handle
+ * is destroyed when the destructor is called, so creating a device has no side effects.
  * @param bus The bus number. Usually 0 or 1 on the BBB
  * @param device The device ID on the bus.
  */
 I2CDevice::I2CDevice(unsigned int bus, unsigned int device) {
 	this->file=-1;
+	this->selected = false;
+	this->transport = NULL;
+	this->recordFile = NULL;
 	this->bus = bus;
 	this->device = device;
-	this->open();
 }
 
 /**
- * Open a connection to an I2C device
- * @return 1 on failure to open to the bus or device, 0 on success.
+ * Open a file handle to the I2C bus. The device address is selected with I2C_SLAVE only before the
+ * first plain write/read; register block reads address the device per message and don't need it.
+ * @return 1 on failure to open to the bus, 0 on success.
  */
 int I2CDevice::open(){
-   string name;
-   if(this->bus==0) name = I2C_0;
-   else name = I2C_1;
-
-   if((this->file=::open(name.c_str(), O_RDWR)) < 0){
+   if(this->file!=-1) return 0;
+   if((this->file=::open(this->bus==0 ? I2C_0 : I2C_1, O_RDWR | O_CLOEXEC)) < 0){
       perror("I2C: failed to open the bus\n");
 	  return 1;
    }
+   this->selected = false;
+   return 0;
+}
+
+/**
+ * Open the bus if needed and make sure the device address is selected for plain write/read calls.
+ * @return 1 on failure to open to the bus or device, 0 on success.
+ */
+int I2CDevice::selectDevice(){
+   if(this->file==-1 && this->open()) return 1;
+   if(this->selected) return 0;
    if(ioctl(this->file, I2C_SLAVE, this->device) < 0){
       perror("I2C: Failed to connect to the device\n");
 	  return 1;
    }
+   this->selected = true;
    return 0;
 }
 
@@ -63,13 +72,33 @@ int I2CDevice::writeRegister(unsigned int registerAddress, unsigned char value){
    unsigned char buffer[2];
    buffer[0] = registerAddress;
    buffer[1] = value;
-   if(::write(this->file, buffer, 2)!=2){
+   if(this->transferWrite(buffer, 2)!=2){
       perror("I2C: Failed write to the device\n");
       return 1;
    }
    return 0;
 }
 
+/**
+ * Write a block of consecutive registers in a single transfer, using the device's register
+ * pointer auto-increment.
+ * @param fromAddress The first register address
+ * @param data The values to write
+ * @param number The number of registers to write (at most 32)
+ * @return 1 on failure to write, 0 on success.
+ */
+int I2CDevice::writeRegisters(unsigned int fromAddress, const unsigned char* data, unsigned int number){
+   unsigned char buffer[33];
+   if(number > sizeof(buffer) - 1) return 1;
+   buffer[0] = fromAddress;
+   for(unsigned int i=0; i<number; i++) buffer[i+1] = data[i];
+   if(this->transferWrite(buffer, number+1)!=(int)number+1){
+      perror("I2C: Failed block write to the device\n");
+      return 1;
+   }
+   return 0;
+}
+
 /**
  * Write a single value to the I2C device. Used to set up the device to read from a
  * particular address.
@@ -79,7 +108,7 @@ int I2CDevice::writeRegister(unsigned int registerAddress, unsigned char value){
 int I2CDevice::write(unsigned char value){
    unsigned char buffer[1];
    buffer[0]=value;
-   if (::write(this->file, buffer, 1)!=1){
+   if (this->transferWrite(buffer, 1)!=1){
       perror("I2C: Failed to write to the device\n");
       return 1;
    }
@@ -92,9 +121,9 @@ int I2CDevice::write(unsigned char value){
  * @return the byte value at the register address.
  */
 unsigned char I2CDevice::readRegister(unsigned int registerAddress){
-   this->write(registerAddress);
+   unsigned char address = registerAddress;
    unsigned char buffer[1];
-   if(::read(this->file, buffer, 1)!=1){
+   if(this->transferWriteRead(&address, 1, buffer, 1)!=1){
       perror("I2C: Failed to read in the value.\n");
       return 1;
    }
@@ -110,45 +139,183 @@ unsigned char I2CDevice::readRegister(unsigned int registerAddress){
  * @return a pointer of type unsigned char* that points to the first element in the block of registers
  */
 unsigned char* I2CDevice::readRegisters(unsigned int number, unsigned int fromAddress){
-	this->write(fromAddress);
 	unsigned char* data = new unsigned char[number];
-    if(::read(this->file, data, number)!=(int)number){
-       perror("IC2: Failed to read in the full buffer.\n");
+	if(this->readRegistersInto(data, number, fromAddress)){
+	   delete[] data;
 	   return NULL;
-    }
+	}
 	return data;
 }
 
+/**
+ * Read a number of registers into a buffer supplied by the caller, so that nothing is allocated.
+ * On the bus, the register address write and the read are sent as one combined I2C_RDWR transfer
+ * (a repeated start), which is a single system call.
+ * @param data the buffer to fill, at least number bytes long
+ * @param number the number of registers to read from the device
+ * @param fromAddress the starting address to read from
+ * @return 1 on failure to read, 0 on success.
+ */
+int I2CDevice::readRegistersInto(unsigned char* data, unsigned int number, unsigned int fromAddress){
+	unsigned char address = fromAddress;
+    if(this->transferWriteRead(&address, 1, data, number)!=(int)number){
+       perror("IC2: Failed to read in the full buffer.\n");
+	   return 1;
+    }
+	return 0;
+}
+
 /**
  * Method to dump the registers to the standard output. It inserts a return character after every
- * 16 values and displays the results in hexadecimal to give a standard output using the HEX() macro
- * that is defined at the top of this file. The standard output will stay in hexadecimal format, hence
- * the call on the last like.
- * @param number the total number of registers to dump, defaults to 0xff
+ * 16 values and displays the results in hexadecimal. The registers are burst-read into a local
+ * buffer and each line is formatted once, rather than streaming every byte through iostream.
+ * @param number the total number of registers to dump, defaults to 0xff (at most 256)
  */
 
 void I2CDevice::debugDumpRegisters(unsigned int number){
-	cout << "Dumping Registers for Debug Purposes:" << endl;
-	unsigned char *registers = this->readRegisters(number);
-	for(int i=0; i<(int)number; i++){
-		cout << HEX(*(registers+i)) << " ";
-		if (i%16==15) cout << endl;
+	printf("Dumping Registers for Debug Purposes:\n");
+	unsigned char registers[256];
+	if(number > sizeof(registers)) number = sizeof(registers);
+	if(number == 0 || this->readRegistersInto(registers, number, 0)) return;
+	char line[16*3 + 2];
+	int length = 0;
+	for(unsigned int i=0; i<number; i++){
+		length += snprintf(line + length, sizeof(line) - length, "%02x ", registers[i]);
+		if (i%16==15 || i==number-1){
+			line[length++] = '\n';
+			fwrite(line, 1, length, stdout);
+			length = 0;
+		}
+	}
+}
+
+/**
+ * Route all transfers through another transport (e.g. an I2CReplay) instead of the bus file handle.
+ * The transport is not owned by the device and must outlive it.
+ * @param transport the transport to use, or NULL to go back to the /dev/i2c-N file handle
+ */
+void I2CDevice::setTransport(I2CTransport *transport){
+	this->transport = transport;
+}
+
+/**
+ * Record every transfer made by this device (address, direction, bytes, time and result) to a
+ * compact binary trace that an I2CReplay can later play back without the hardware.
+ * @param path the trace file to create
+ * @return 1 on failure to create the file, 0 on success.
+ */
+int I2CDevice::startRecording(const char *path){
+	this->stopRecording();
+	if((this->recordFile = fopen(path, "wb")) == NULL){
+		perror("I2C: Failed to create the trace file\n");
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &this->recordStart);
+	I2CTraceHeader header = { {'I', '2', 'C', 'T'}, I2C_TRACE_VERSION, 0 };
+	fwrite(&header, sizeof(header), 1, this->recordFile);
+	return 0;
+}
+
+/**
+ * Flush and close the trace file, if recording.
+ */
+void I2CDevice::stopRecording(){
+	if(this->recordFile == NULL) return;
+	fclose(this->recordFile);
+	this->recordFile = NULL;
+}
+
+/**
+ * Append a host clock read to the trace, if recording, so that a replay hands the driver the same
+ * time (see I2CReplay::timeSource()) and writes the same bytes.
+ */
+void I2CDevice::recordTime(time_t value){
+	if(this->recordFile == NULL) return;
+	int64_t stored = value;
+	this->record(I2C_TRACE_TIME, (const unsigned char*)&stored, sizeof(stored), sizeof(stored));
+}
+
+/**
+ * Append one transfer to the trace file. Records are buffered by stdio and only reach the disk
+ * in blocks, so recording adds no extra system calls per transfer. A write keeps all the bytes
+ * sent; a read keeps only the bytes actually received, so a short read replays as a short read.
+ * @param n the transfer's return value: bytes transferred, or -1 on failure
+ */
+void I2CDevice::record(unsigned char direction, const unsigned char *data, unsigned int length, int n){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	I2CTraceRecord r;
+	r.timestampNs = (uint64_t)(now.tv_sec - this->recordStart.tv_sec) * 1000000000ull
+			+ now.tv_nsec - this->recordStart.tv_nsec;
+	r.address = this->device;
+	r.direction = direction;
+	if(direction == I2C_TRACE_READ){
+		r.result = n < 0 ? 1 : 0;
+		r.length = n < 0 ? 0 : ((unsigned int)n < length ? n : length);
+	} else {
+		r.result = n != (int)length ? 1 : 0;
+		r.length = length;
+	}
+	fwrite(&r, sizeof(r), 1, this->recordFile);
+	fwrite(data, 1, r.length, this->recordFile);
+}
+
+int I2CDevice::transferWrite(const unsigned char *data, unsigned int length){
+	int n;
+	if(this->transport) n = this->transport->write(this->device, data, length);
+	else n = this->selectDevice() ? -1 : ::write(this->file, data, length);
+	if(this->recordFile) this->record(I2C_TRACE_WRITE, data, length, n);
+	return n;
+}
+
+int I2CDevice::transferRead(unsigned char *data, unsigned int length){
+	int n;
+	if(this->transport) n = this->transport->read(this->device, data, length);
+	else n = this->selectDevice() ? -1 : ::read(this->file, data, length);
+	if(this->recordFile) this->record(I2C_TRACE_READ, data, length, n);
+	return n;
+}
+
+/**
+ * Write then read without releasing the bus in between. Transports (and recordings) see it as a
+ * write followed by a read.
+ * @return the number of bytes read, or -1 on failure
+ */
+int I2CDevice::transferWriteRead(const unsigned char *out, unsigned int outLength, unsigned char *in, unsigned int inLength){
+	if(this->transport){
+		if(this->transferWrite(out, outLength)!=(int)outLength) return -1;
+		return this->transferRead(in, inLength);
+	}
+	int n = -1;
+	if(this->file!=-1 || this->open()==0){
+		struct i2c_msg messages[2] = {
+			{ (__u16)this->device, 0, (__u16)outLength, (__u8*)out },
+			{ (__u16)this->device, I2C_M_RD, (__u16)inLength, in }
+		};
+		struct i2c_rdwr_ioctl_data transfer = { messages, 2 };
+		if(ioctl(this->file, I2C_RDWR, &transfer) == 2) n = inLength;
+	}
+	if(this->recordFile){
+		this->record(I2C_TRACE_WRITE, out, outLength, n<0 ? -1 : (int)outLength);
+		this->record(I2C_TRACE_READ, in, inLength, n);
 	}
-	cout << dec;
+	return n;
 }
 
 /**
  * Close the file handles and sets a temporary state to -1.
  */
 void I2CDevice::close(){
-	::close(this->file);
+	if(this->file!=-1) ::close(this->file);
 	this->file = -1;
+	this->selected = false;
 }
 
 /**
  * Closes the file on destruction, provided that it has not already been closed.
  */
 I2CDevice::~I2CDevice() {
+	this->stopRecording();
 	if(file!=-1) this->close();
 }
 
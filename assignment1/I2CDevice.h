@@ -9,6 +9,10 @@
 #define I2C_0 "/dev/i2c-0"
 #define I2C_1 "/dev/i2c-1"
 
+#include "I2CTransport.h"
+#include <stdio.h>
+#include <time.h>
+
 namespace een1071 {
 
 /**
@@ -21,6 +25,15 @@ private:
 	unsigned int bus;
 	unsigned int device;
 	int file;
+	bool selected;
+	I2CTransport *transport;
+	FILE *recordFile;
+	struct timespec recordStart;
+	int transferWrite(const unsigned char *data, unsigned int length);
+	int transferRead(unsigned char *data, unsigned int length);
+	int transferWriteRead(const unsigned char *out, unsigned int outLength, unsigned char *in, unsigned int inLength);
+	int selectDevice();
+	void record(unsigned char direction, const unsigned char *data, unsigned int length, int n);
 public:
 	I2CDevice(unsigned int bus, unsigned int device);
 	virtual int open();
@@ -31,6 +44,13 @@ public:
 	virtual void debugDumpRegisters(unsigned int number = 0xff);
 	virtual void close();
 	virtual ~I2CDevice();
+	// Non-virtual and after the original virtuals, so the vtable layout is unchanged
+	int readRegistersInto(unsigned char* data, unsigned int number, unsigned int fromAddress);
+	int writeRegisters(unsigned int fromAddress, const unsigned char* data, unsigned int number);
+	void setTransport(I2CTransport *transport);
+	int startRecording(const char *path);
+	void stopRecording();
+	void recordTime(time_t value);
 };
 
 } /* namespace een1071 */
@@ -0,0 +1,148 @@
+/*
+ * I2CReplay.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "I2CReplay.h"
+#include "Trace.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+namespace een1071 {
+
+/**
+ * Constructor for the replay transport. Call load() before handing it to I2CDevice::setTransport().
+ * @param realTime true to reproduce the recorded timing, false to replay as fast as possible
+ */
+I2CReplay::I2CReplay(bool realTime) {
+	this->next = 0;
+	this->realTime = realTime;
+	this->started = false;
+	this->divergenceCount = 0;
+}
+
+/**
+ * Read a whole trace file into memory so that replay itself does no file I/O.
+ * @param path the trace file written by I2CDevice::startRecording()
+ * @return 1 on failure to open or parse the file, 0 on success.
+ */
+int I2CReplay::load(const char *path){
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL){
+		perror("I2C: Failed to open the replay trace\n");
+		return 1;
+	}
+	I2CTraceHeader header;
+	if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, I2C_TRACE_MAGIC, 4) != 0
+			|| header.version != I2C_TRACE_VERSION){
+		fclose(fp);
+		TRACE_E("I2C: Replay file is not a version %d trace", I2C_TRACE_VERSION);
+		return 1;
+	}
+	this->transfers.clear();
+	this->data.clear();
+	Transfer t;
+	while(fread(&t.record, sizeof(t.record), 1, fp) == 1){
+		t.offset = this->data.size();
+		this->data.resize(t.offset + t.record.length);
+		if(t.record.length && fread(&this->data[t.offset], 1, t.record.length, fp) != t.record.length){
+			TRACE_E("I2C: Truncated record %d in replay trace", (int)this->transfers.size());
+			break;
+		}
+		this->transfers.push_back(t);
+	}
+	fclose(fp);
+	this->rewind();
+	return 0;
+}
+
+/**
+ * Start again from the first recorded transfer.
+ */
+void I2CReplay::rewind(){
+	this->next = 0;
+	this->started = false;
+	this->divergenceCount = 0;
+}
+
+/**
+ * Consume the next recorded host clock read. If the driver reads the clock where the recording
+ * has a bus transfer, that is a divergence and the host clock is returned instead.
+ */
+time_t I2CReplay::takeTime(){
+	if(this->finished() || this->transfers[this->next].record.direction != I2C_TRACE_TIME){
+		this->divergenceCount++;
+		TRACE_E("I2C: Replay diverged at transfer %d (clock read)", (int)this->next);
+		return time(NULL);
+	}
+	const Transfer *t = &this->transfers[this->next++];
+	this->pace(t->record.timestampNs);
+	int64_t value = 0;
+	memcpy(&value, &this->data[t->offset], t->record.length < sizeof(value) ? t->record.length : sizeof(value));
+	return (time_t)value;
+}
+
+// Matches the DS3231::setTimeSource() callback: DS3231::setTimeSource(I2CReplay::timeSource, &replay)
+time_t I2CReplay::timeSource(void *replay){
+	return ((I2CReplay*)replay)->takeTime();
+}
+
+/**
+ * Sleep until the recorded time of a transfer, measured from the first recorded transfer (not from
+ * startRecording(), so any idle time before the first transfer is not waited out again).
+ */
+void I2CReplay::pace(uint64_t timestampNs){
+	if(!this->started){
+		clock_gettime(CLOCK_MONOTONIC, &this->start);
+		this->started = true;
+	}
+	if(!this->realTime) return;
+	uint64_t ns = (uint64_t)this->start.tv_nsec + (timestampNs - this->transfers[0].record.timestampNs);
+	struct timespec due;
+	due.tv_sec = this->start.tv_sec + ns / 1000000000ull;
+	due.tv_nsec = ns % 1000000000ull;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {}
+}
+
+/**
+ * Consume the next transfer, counting a divergence if it does not match what the driver asks for.
+ * @return the recorded transfer, or NULL once the trace is exhausted
+ */
+const I2CReplay::Transfer* I2CReplay::take(unsigned char address, uint8_t direction, unsigned int length){
+	if(this->finished()){
+		if(this->divergenceCount++ == 0) TRACE_E("I2C: Replay trace exhausted");
+		return NULL;
+	}
+	const Transfer *t = &this->transfers[this->next++];
+	this->pace(t->record.timestampNs);
+	// A recorded read may be shorter than requested (a short read); anything else must match
+	bool lengthMatches = direction == I2C_TRACE_READ ? t->record.length <= length : t->record.length == length;
+	if(t->record.address != address || t->record.direction != direction || !lengthMatches){
+		this->divergenceCount++;
+		TRACE_E("I2C: Replay diverged at transfer %d (dir %d, len %d)", (int)(this->next - 1), direction, (int)length);
+	}
+	return t;
+}
+
+int I2CReplay::write(unsigned char address, const unsigned char *data, unsigned int length){
+	const Transfer *t = this->take(address, I2C_TRACE_WRITE, length);
+	if(t == NULL) return -1;
+	if(t->record.length == length && memcmp(&this->data[t->offset], data, length) != 0){
+		this->divergenceCount++;
+		TRACE_E("I2C: Replay wrote different bytes at transfer %d", (int)(this->next - 1));
+	}
+	return t->record.result ? -1 : (int)length;
+}
+
+int I2CReplay::read(unsigned char address, unsigned char *data, unsigned int length){
+	const Transfer *t = this->take(address, I2C_TRACE_READ, length);
+	if(t == NULL) return -1;
+	unsigned int n = t->record.length < length ? t->record.length : length;
+	memcpy(data, &this->data[t->offset], n);
+	return t->record.result ? -1 : (int)n;
+}
+
+} /* namespace een1071 */
@@ -0,0 +1,82 @@
+/*
+ * I2CReplay.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef I2CREPLAY_H_
+#define I2CREPLAY_H_
+
+#include "I2CTransport.h"
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+#define I2C_TRACE_MAGIC "I2CT"
+#define I2C_TRACE_VERSION 2
+
+#define I2C_TRACE_WRITE 0
+#define I2C_TRACE_READ 1
+#define I2C_TRACE_TIME 2   // a host clock read; the data is the int64_t time() value
+
+namespace een1071 {
+
+/*
+ * Binary trace file layout (little endian, as written by I2CDevice::startRecording()):
+ * one I2CTraceHeader, then for every transfer an I2CTraceRecord followed by `length` data bytes.
+ */
+struct __attribute__((packed)) I2CTraceHeader {
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+};
+
+struct __attribute__((packed)) I2CTraceRecord {
+	uint64_t timestampNs;   // CLOCK_MONOTONIC time since the recording started
+	uint8_t address;
+	uint8_t direction;      // I2C_TRACE_WRITE, I2C_TRACE_READ or I2C_TRACE_TIME
+	uint8_t result;         // 0 on success, 1 on failure
+	uint16_t length;        // bytes written, or bytes actually read
+};
+
+/**
+ * @class I2CReplay
+ * @brief Transport that plays back a recorded trace file instead of touching the bus. Writes are
+ * checked against the recording (any mismatch is counted as a divergence), reads return the recorded
+ * bytes. Transfers are either paced at the recorded speed or run back to back as fast as possible.
+ * timeSource() hands the driver the host clock values read during the recording, in order, so code
+ * that reads the host clock (e.g. DS3231::setTimeDate()) writes the same bytes it wrote when recorded.
+ */
+class I2CReplay:public I2CTransport{
+private:
+	struct Transfer {
+		I2CTraceRecord record;
+		size_t offset;   // of the data bytes in `data`
+	};
+	std::vector<Transfer> transfers;
+	std::vector<unsigned char> data;
+	size_t next;
+	bool realTime;
+	bool started;
+	struct timespec start;
+	unsigned int divergenceCount;
+
+	const Transfer* take(unsigned char address, uint8_t direction, unsigned int length);
+	void pace(uint64_t timestampNs);
+public:
+	I2CReplay(bool realTime = false);
+	int load(const char *path);
+	void rewind();
+	bool finished() const { return next >= transfers.size(); }
+	unsigned int divergences() const { return divergenceCount; }
+	size_t position() const { return next; }
+	size_t size() const { return transfers.size(); }
+	time_t takeTime();
+	static time_t timeSource(void *replay);
+	virtual int write(unsigned char address, const unsigned char *data, unsigned int length);
+	virtual int read(unsigned char address, unsigned char *data, unsigned int length);
+};
+
+} /* namespace een1071 */
+
+#endif /* I2CREPLAY_H_ */
@@ -0,0 +1,27 @@
+/*
+ * I2CTransport.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef I2CTRANSPORT_H_
+#define I2CTRANSPORT_H_
+
+namespace een1071 {
+
+/**
+ * @class I2CTransport
+ * @brief Raw byte transfers to a device on an I2C bus. I2CDevice uses the /dev/i2c-N file handle
+ * unless a transport is injected with I2CDevice::setTransport(), e.g. to replay a recorded trace.
+ * Both calls return the number of bytes transferred, or -1 on failure (like ::write and ::read).
+ */
+class I2CTransport{
+public:
+	virtual int write(unsigned char address, const unsigned char *data, unsigned int length) = 0;
+	virtual int read(unsigned char address, unsigned char *data, unsigned int length) = 0;
+	virtual ~I2CTransport() {}
+};
+
+} /* namespace een1071 */
+
+#endif /* I2CTRANSPORT_H_ */
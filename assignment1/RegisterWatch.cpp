@@ -0,0 +1,97 @@
+/*
+ * RegisterWatch.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "RegisterWatch.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace een1071 {
+
+    // Index of the lowest-addressed byte that differs in a non-zero XOR of two words
+    static inline unsigned int firstChangedByte(uint64_t diff) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return __builtin_ctzll(diff) >> 3;
+#else
+        return __builtin_clzll(diff) >> 3;
+#endif
+    }
+
+    static inline uint64_t byteMask(unsigned int byte) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return 0xFFull << (byte * 8);
+#else
+        return 0xFFull << ((7 - byte) * 8);
+#endif
+    }
+
+    RegisterWatch::RegisterWatch(I2CDevice &device, unsigned int fromAddress, unsigned int number)
+        : device(device), fromAddress(fromAddress),
+          number(number > WATCH_MAX_REGISTERS ? WATCH_MAX_REGISTERS : number),
+          snapshotCount(0), changeCount(0) {
+        memset(previous, 0, sizeof(previous));
+        memset(current, 0, sizeof(current));
+    }
+
+    void RegisterWatch::emit(FILE *out, bool binary, uint64_t timestampNs, unsigned int index, unsigned char oldValue) {
+        changeCount++;
+        if (binary) {
+            WatchRecord r = { timestampNs, (uint8_t)(fromAddress + index), oldValue, current[index] };
+            fwrite(&r, sizeof(r), 1, out);
+        } else {
+            fprintf(out, "%llu.%06llu 0x%02x: %02x -> %02x\n", (unsigned long long)(timestampNs / 1000000000ull),
+                    (unsigned long long)(timestampNs % 1000000000ull) / 1000, fromAddress + index, oldValue, current[index]);
+        }
+    }
+
+    /**
+     * Watch until *stop is set (e.g. from a SIGINT handler).
+     * @param out where to write the changes, flushed after every snapshot that had any
+     * @param binary write WatchRecords instead of text lines
+     * @param intervalUs pause between reads, 0 to read back to back
+     * @return 1 if a read fails, 0 when stopped.
+     */
+    int RegisterWatch::run(FILE *out, bool binary, volatile sig_atomic_t *stop, unsigned int intervalUs) {
+        const unsigned int words = (number + 7) / 8;
+        bool first = true;
+
+        while (!*stop) {
+            if (device.readRegistersInto(current, number, fromAddress)) return 1;
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            uint64_t timestampNs = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+            snapshotCount++;
+
+            bool changed = false;
+            if (first) {
+                for (unsigned int i = 0; i < number; i++) emit(out, binary, timestampNs, i, current[i]);
+                changed = true;
+                first = false;
+            } else {
+                for (unsigned int w = 0; w < words; w++) {
+                    uint64_t a, b;
+                    memcpy(&a, previous + w * 8, 8);
+                    memcpy(&b, current + w * 8, 8);
+                    uint64_t diff = a ^ b;
+                    while (diff) {
+                        unsigned int byte = firstChangedByte(diff);
+                        diff &= ~byteMask(byte);
+                        emit(out, binary, timestampNs, w * 8 + byte, previous[w * 8 + byte]);
+                    }
+                    changed |= a != b;
+                }
+            }
+
+            if (changed) {
+                fflush(out);
+                memcpy(previous, current, words * 8);
+            }
+            if (intervalUs) usleep(intervalUs);
+        }
+        return 0;
+    }
+
+} /* namespace een1071 */
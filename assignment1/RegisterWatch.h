@@ -0,0 +1,55 @@
+/*
+ * RegisterWatch.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef REGISTERWATCH_H_
+#define REGISTERWATCH_H_
+
+#include "I2CDevice.h"
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define WATCH_MAX_REGISTERS 256
+
+namespace een1071 {
+
+    // Binary output record: one per changed register
+    struct __attribute__((packed)) WatchRecord {
+        uint64_t timestampNs;   // host CLOCK_REALTIME
+        uint8_t reg;
+        uint8_t oldValue;
+        uint8_t newValue;
+    };
+
+    /**
+     * @brief Watches a window of registers live: burst-reads it in a tight loop, compares each
+     * snapshot with the previous one eight bytes at a time and writes out only the registers that
+     * changed, with the host time of the read. Nothing is allocated or formatted for unchanged
+     * snapshots. The first snapshot is written out in full so the stream stands on its own.
+     */
+    class RegisterWatch {
+    public:
+        RegisterWatch(I2CDevice &device, unsigned int fromAddress, unsigned int number);
+        int run(FILE *out, bool binary, volatile sig_atomic_t *stop, unsigned int intervalUs = 0);
+        unsigned long snapshots() const { return snapshotCount; }
+        unsigned long changes() const { return changeCount; }
+
+    private:
+        void emit(FILE *out, bool binary, uint64_t timestampNs, unsigned int index, unsigned char oldValue);
+
+        I2CDevice &device;
+        unsigned int fromAddress;
+        unsigned int number;
+        // Padded to whole 64-bit words; the padding stays zero in both buffers
+        alignas(8) unsigned char previous[WATCH_MAX_REGISTERS];
+        alignas(8) unsigned char current[WATCH_MAX_REGISTERS];
+        unsigned long snapshotCount;
+        unsigned long changeCount;
+    };
+
+} /* namespace een1071 */
+
+#endif /* REGISTERWATCH_H_ */
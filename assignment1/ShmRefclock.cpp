@@ -0,0 +1,134 @@
+/*
+ * ShmRefclock.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "ShmRefclock.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace een1071 {
+
+    ShmRefclock::ShmRefclock(int unit) : unit(unit), shm(nullptr) {}
+
+    ShmRefclock::~ShmRefclock() {
+        close();
+    }
+
+    /**
+     * Attach to (or create) the segment. Units 0 and 1 are root-only, like ntpd creates them.
+     * @return 1 on failure, 0 on success.
+     */
+    int ShmRefclock::open() {
+        if (shm) return 0;
+        int id = shmget(NTP_SHM_KEY + unit, sizeof(NtpShmTime), IPC_CREAT | (unit < 2 ? 0600 : 0666));
+        if (id < 0) {
+            perror("Can't get the NTP SHM segment.");
+            return 1;
+        }
+        void *p = shmat(id, NULL, 0);
+        if (p == (void*)-1) {
+            perror("Can't attach the NTP SHM segment.");
+            return 1;
+        }
+        shm = (NtpShmTime*)p;
+        return 0;
+    }
+
+    void ShmRefclock::close() {
+        if (!shm) return;
+        shmdt(shm);
+        shm = nullptr;
+    }
+
+    // Mode 1 update: readers retry if count changed while they copied the sample
+    void ShmRefclock::publish(const struct timespec &clock, const struct timespec &receive) {
+        if (!shm) return;
+        shm->valid = 0;
+        shm->mode = 1;
+        shm->count = shm->count + 1;
+        __sync_synchronize();
+        shm->clockTimeStampSec = clock.tv_sec;
+        shm->clockTimeStampUSec = clock.tv_nsec / 1000;
+        shm->clockTimeStampNSec = clock.tv_nsec;
+        shm->receiveTimeStampSec = receive.tv_sec;
+        shm->receiveTimeStampUSec = receive.tv_nsec / 1000;
+        shm->receiveTimeStampNSec = receive.tv_nsec;
+        shm->leap = 0;
+        shm->precision = -10;   // ~1 ms, the edge timestamp is taken in user space
+        shm->nsamples = 3;
+        __sync_synchronize();
+        shm->count = shm->count + 1;
+        shm->valid = 1;
+    }
+
+    SqwRefclock::SqwRefclock(DS3231 &rtc, EdgeSource &edges, ShmRefclock &shm)
+        : rtc(rtc), edges(edges), shm(shm), samples(0), skipped(0) {}
+
+    /**
+     * Publish one sample per SQW edge until *stop is set (e.g. from a SIGINT handler).
+     * A sample is only published when the RTC second advanced by exactly one since the previous
+     * edge, which drops reads that raced the rollover and edges lost by the edge source, and only
+     * while the oscillator stop flag is clear: with OSF set the RTC counts from an invalid time.
+     * @return 1 if the segment or the SQW output can't be set up or restored, 0 when stopped.
+     */
+    int SqwRefclock::run(volatile sig_atomic_t *stop) {
+        if (shm.open()) return 1;
+        unsigned char r[STATUS_REG + 1];
+        if (rtc.readRegistersInto(r, sizeof(r), RTC_SECONDS)) return 1;
+        unsigned char control = r[CONTROL_REG] & ~CONTROL_CONV;   // don't start a conversion when writing it back
+        bool stopped = r[STATUS_REG] & STATUS_OSF;
+        if (stopped) TRACE_E("Oscillator stop flag set, not publishing until the RTC time is set");
+        int encoded = DS3231::encodeSQW(control, 1);
+        if (rtc.writeRegister(CONTROL_REG, encoded)) return 1;
+
+        time_t previous = 0;
+        while (!*stop) {
+            struct timespec edge;
+            if (edges.waitEdge(edge, 2000)) {
+                TRACE_E("No SQW edge for 2 s");
+                previous = 0;
+                continue;
+            }
+
+            // One burst from the seconds to STATUS_REG gets the time and OSF together
+            if (rtc.readRegistersInto(r, sizeof(r), RTC_SECONDS)) {
+                skipped++;
+                previous = 0;
+                continue;
+            }
+            if (r[STATUS_REG] & STATUS_OSF) {
+                if (!stopped) TRACE_E("Oscillator stop flag set, not publishing until the RTC time is set");
+                stopped = true;
+                skipped++;
+                previous = 0;
+                continue;
+            }
+            stopped = false;
+
+            struct tm t;
+            decodeTimeRegisters(r, t);
+            time_t second = timegm(&t);   // the RTC keeps UTC, so no DST jumps
+            if (second != previous + 1) {
+                skipped += previous != 0;
+                previous = second;
+                continue;
+            }
+            previous = second;
+
+            struct timespec clock = { second, 0 };
+            shm.publish(clock, edge);
+            samples++;
+            TRACE_D("SHM sample %d, offset %d us", (int)samples,
+                    (int)((second - edge.tv_sec) * 1000000L - edge.tv_nsec / 1000));
+        }
+
+        // Give INT/SQW back to interrupt mode and the alarm enables it had before
+        if (rtc.writeRegister(CONTROL_REG, control)) return 1;
+        return 0;
+    }
+
+} /* namespace een1071 */
@@ -0,0 +1,77 @@
+/*
+ * ShmRefclock.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef SHMREFCLOCK_H_
+#define SHMREFCLOCK_H_
+
+#include "DS3231.h"
+#include "EdgeSource.h"
+#include <signal.h>
+#include <time.h>
+
+#define NTP_SHM_KEY 0x4e545030   // "NTP0", unit N uses NTP_SHM_KEY + N
+
+namespace een1071 {
+
+    // Segment layout shared with ntpd's SHM driver and chronyd's "refclock SHM"
+    struct NtpShmTime {
+        int mode;                  // 1: use the count field to detect torn updates
+        volatile int count;
+        time_t clockTimeStampSec;  // reference (RTC) time
+        int clockTimeStampUSec;
+        time_t receiveTimeStampSec;  // host time it was taken at
+        int receiveTimeStampUSec;
+        int leap;
+        int precision;             // log2 of the precision in seconds
+        int nsamples;
+        volatile int valid;
+        unsigned clockTimeStampNSec;
+        unsigned receiveTimeStampNSec;
+        int dummy[8];
+    };
+
+    /**
+     * @brief One NTP SHM reference clock segment (e.g. "refclock SHM 0" in chrony.conf).
+     */
+    class ShmRefclock {
+    public:
+        ShmRefclock(int unit = 0);
+        ~ShmRefclock();
+        int open();
+        void close();
+        void publish(const struct timespec &clock, const struct timespec &receive);
+
+    private:
+        int unit;
+        NtpShmTime *shm;
+    };
+
+    /**
+     * @brief Disciplines the host clock from the DS3231: runs the SQW output at 1 Hz, reads the RTC
+     * right after each falling edge (when the seconds register has just rolled over) and publishes the
+     * pair (RTC second, host time of the edge) to an NTP SHM segment. The loop sleeps in the edge
+     * source between edges, so it costs one 16-byte register read (time through STATUS_REG) per
+     * second. The RTC must keep UTC (set it with setTimeDate(true)); local time would be an hour off
+     * across every DST change. Nothing is published while the oscillator stop flag (OSF) is set.
+     */
+    class SqwRefclock {
+    public:
+        SqwRefclock(DS3231 &rtc, EdgeSource &edges, ShmRefclock &shm);
+        int run(volatile sig_atomic_t *stop);
+        unsigned long published() const { return samples; }
+        unsigned long rejected() const { return skipped; }
+
+    private:
+        DS3231 &rtc;
+        EdgeSource &edges;
+        ShmRefclock &shm;
+        unsigned long samples;
+        unsigned long skipped;
+    };
+
+} /* namespace een1071 */
+
+#endif /* SHMREFCLOCK_H_ */
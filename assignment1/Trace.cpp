@@ -0,0 +1,195 @@
+/*
+ * Trace.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <time.h>
+
+using namespace std;
+
+namespace een1071 {
+namespace trace {
+
+    /**
+     * Single producer (the owning thread), single consumer (the drain thread) ring of records.
+     * A full ring drops the new record instead of blocking the caller.
+     */
+    struct Ring {
+        Record records[TRACE_RING_SIZE];
+        atomic<unsigned> head{0};   // next slot written by the producer
+        atomic<unsigned> tail{0};   // next slot read by the drain thread
+        atomic<bool> retired{false};  // owning thread has exited, free once drained
+    };
+
+    static const char *levelPrefix[] = { "", "Error: ", "", "" };
+
+    class Sink {
+    public:
+        ~Sink() { stop(); }
+
+        Ring *registerRing() {
+            Ring *ring = new Ring();
+            lock_guard<mutex> lock(m);
+            rings.push_back(ring);
+            if (!running && !stopped) {
+                running = true;
+                drainThread = thread(&Sink::run, this);
+            }
+            return ring;
+        }
+
+        void flush() {
+            unique_lock<mutex> lock(m);
+            if (!running) return;
+            unsigned long target = ++flushRequested;
+            wake.notify_one();
+            flushed.wait(lock, [&] { return flushDone >= target || !running; });
+        }
+
+        void stop() {
+            {
+                lock_guard<mutex> lock(m);
+                if (!running) return;
+                running = false;
+                stopped = true;
+            }
+            wake.notify_one();
+            drainThread.join();
+            // Rings of live threads stay allocated: those threads may still push into theirs
+            drainAll();
+        }
+
+        atomic<unsigned long> droppedCount{0};   // since the last drain
+        atomic<unsigned long> droppedTotal{0};
+
+    private:
+        void run() {
+            unique_lock<mutex> lock(m);
+            while (running) {
+                unsigned long request = flushRequested;
+                lock.unlock();
+                drainAll();
+                lock.lock();
+                flushDone = request;
+                flushed.notify_all();
+                // Producers never signal, the drain thread simply polls at a low rate
+                wake.wait_for(lock, chrono::milliseconds(20), [&] { return !running || flushRequested != flushDone; });
+            }
+            flushed.notify_all();
+        }
+
+        void drainAll() {
+            vector<Ring*> snapshot;
+            {
+                lock_guard<mutex> lock(m);
+                snapshot = rings;
+            }
+            bool wrote = false;
+            for (Ring *ring : snapshot) {
+                // Checked before head: a retired ring gets no more records after this
+                bool retired = ring->retired.load(memory_order_acquire);
+                unsigned tail = ring->tail.load(memory_order_relaxed);
+                unsigned head = ring->head.load(memory_order_acquire);
+                while (tail != head) {
+                    format(ring->records[tail & (TRACE_RING_SIZE - 1)]);
+                    tail++;
+                    wrote = true;
+                }
+                ring->tail.store(tail, memory_order_release);
+                if (retired) {
+                    lock_guard<mutex> lock(m);
+                    rings.erase(find(rings.begin(), rings.end(), ring));
+                    delete ring;
+                }
+            }
+            unsigned long lost = droppedCount.exchange(0);
+            if (lost) {
+                fprintf(stdout, "Error: %lu trace records dropped\n", lost);
+                wrote = true;
+            }
+            if (wrote) fflush(stdout);
+        }
+
+        void format(const Record &r) {
+            char line[256];
+            snprintf(line, sizeof(line), r.format, r.args[0], r.args[1], r.args[2], r.args[3]);
+            if (r.level == TRACE_DEBUG) {
+                fprintf(stdout, "[%llu.%06llu] ", (unsigned long long)(r.timestampNs / 1000000000ull),
+                        (unsigned long long)(r.timestampNs % 1000000000ull) / 1000);
+            }
+            fprintf(stdout, "%s%s\n", levelPrefix[r.level & 0x03], line);
+        }
+
+        mutex m;
+        condition_variable wake;
+        condition_variable flushed;
+        vector<Ring*> rings;
+        thread drainThread;
+        bool running = false;
+        bool stopped = false;
+        unsigned long flushRequested = 0;
+        unsigned long flushDone = 0;
+    };
+
+    static Sink sink;
+
+    // Hands the thread's ring back to the drain thread when the thread exits
+    struct RingOwner {
+        Ring *ring = nullptr;
+        ~RingOwner() { if (ring) ring->retired.store(true, memory_order_release); }
+    };
+    static thread_local RingOwner localRing;
+
+    void push(unsigned char level, const char *format, const int *args, unsigned char argCount) {
+        Ring *ring = localRing.ring;
+        if (!ring) ring = localRing.ring = sink.registerRing();
+
+        unsigned head = ring->head.load(memory_order_relaxed);
+        if (head - ring->tail.load(memory_order_acquire) >= TRACE_RING_SIZE) {
+            sink.droppedCount.fetch_add(1, memory_order_relaxed);
+            sink.droppedTotal.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        Record &r = ring->records[head & (TRACE_RING_SIZE - 1)];
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        r.timestampNs = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        r.format = format;
+        r.level = level;
+        r.argCount = argCount;
+        for (int i = 0; i < TRACE_MAX_ARGS; i++) r.args[i] = i < argCount ? args[i] : 0;
+        ring->head.store(head + 1, memory_order_release);
+    }
+
+    /**
+     * Block until every record pushed before this call has been written out. Call it before
+     * interleaving direct console output (e.g. a user prompt) with traced driver output.
+     */
+    void flush() {
+        sink.flush();
+    }
+
+    /**
+     * Stop the drain thread after writing all pending records. Also runs at static destruction.
+     */
+    void shutdown() {
+        sink.stop();
+    }
+
+    // Records lost to full rings since the program started
+    unsigned long dropped() {
+        return sink.droppedTotal.load(memory_order_relaxed);
+    }
+
+} /* namespace trace */
+} /* namespace een1071 */
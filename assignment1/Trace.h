@@ -0,0 +1,74 @@
+/*
+ * Trace.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#define TRACE_OFF 0
+#define TRACE_ERROR 1
+#define TRACE_INFO 2
+#define TRACE_DEBUG 3
+
+// Highest level compiled in. Build with -DRTC_TRACE_LEVEL=TRACE_OFF to strip every trace call.
+#ifndef RTC_TRACE_LEVEL
+#define RTC_TRACE_LEVEL TRACE_INFO
+#endif
+
+#define TRACE_MAX_ARGS 4
+#define TRACE_RING_SIZE 256   // records per thread, must be a power of 2
+
+namespace een1071 {
+namespace trace {
+
+    /**
+     * @brief One binary trace record. Nothing is formatted on the calling thread: the record keeps
+     * a pointer to the (static) printf format string and up to TRACE_MAX_ARGS integer arguments.
+     */
+    struct Record {
+        uint64_t timestampNs;
+        const char *format;
+        int args[TRACE_MAX_ARGS];
+        unsigned char level;
+        unsigned char argCount;
+    };
+
+    void push(unsigned char level, const char *format, const int *args, unsigned char argCount);
+    void flush();
+    void shutdown();
+    unsigned long dropped();
+
+    template<typename... Args>
+    inline void emit(unsigned char level, const char *format, Args... args) {
+        static_assert(sizeof...(Args) <= TRACE_MAX_ARGS, "too many trace arguments");
+        const int packed[TRACE_MAX_ARGS + 1] = { (int)args... };
+        push(level, format, packed, sizeof...(Args));
+    }
+
+} /* namespace trace */
+} /* namespace een1071 */
+
+// Format strings must be string literals and arguments must convert to int
+#if RTC_TRACE_LEVEL >= TRACE_ERROR
+#define TRACE_E(...) een1071::trace::emit(TRACE_ERROR, __VA_ARGS__)
+#else
+#define TRACE_E(...) ((void)0)
+#endif
+
+#if RTC_TRACE_LEVEL >= TRACE_INFO
+#define TRACE_I(...) een1071::trace::emit(TRACE_INFO, __VA_ARGS__)
+#else
+#define TRACE_I(...) ((void)0)
+#endif
+
+#if RTC_TRACE_LEVEL >= TRACE_DEBUG
+#define TRACE_D(...) een1071::trace::emit(TRACE_DEBUG, __VA_ARGS__)
+#else
+#define TRACE_D(...) ((void)0)
+#endif
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,135 @@
+/*
+ * WaveformSequencer.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#include "WaveformSequencer.h"
+#include "Trace.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pigpio.h>
+
+using namespace std;
+
+namespace een1071 {
+
+    static long elapsedNs(const struct timespec &from, const struct timespec &to) {
+        return (to.tv_sec - from.tv_sec) * 1000000000L + (to.tv_nsec - from.tv_nsec);
+    }
+
+    // Default output: drive the LED PWM through pigpio
+    static void pigpioOutput(const WaveformStep &step, void *) {
+        gpioPWM(LED_PIN, step.ledOn ? step.pwmDuty : 0);
+    }
+
+    WaveformSequencer::WaveformSequencer(DS3231 &rtc) : rtc(rtc), output(pigpioOutput), userData(nullptr),
+                                                         running(false), realTime(false) {}
+
+    // Replace the pigpio PWM output, e.g. with a no-op when running against a DS3231Sim
+    void WaveformSequencer::setOutput(WaveformOutputFunc output, void *userData) {
+        this->output = output;
+        this->userData = userData;
+    }
+
+    /**
+     * Encode all steps and start playing them. The control register is read once here and every
+     * step only changes its INTCN/RS bits, so the alarm enables set elsewhere are preserved.
+     * Falls back to a normal thread when SCHED_FIFO is not permitted (i.e. not running as root).
+     * @return 1 if CONTROL_REG can't be read, a step is invalid or the thread can't be started, 0 on success.
+     */
+    int WaveformSequencer::start(const vector<WaveformStep> &steps, int priority) {
+        if (running) return 1;
+
+        unsigned char control;
+        if (rtc.readRegistersInto(&control, 1, CONTROL_REG)) return 1;
+        control &= ~CONTROL_CONV;   // a 1 read mid-conversion would start a conversion on every step
+        slots.clear();
+        for (size_t i = 0; i < steps.size(); i++) {
+            int encoded = DS3231::encodeSQW(control, steps[i].sqwFrequency);
+            if (encoded < 0) {
+                TRACE_E("Step %d: invalid SQW frequency %d", (int)i, steps[i].sqwFrequency);
+                return 1;
+            }
+            Slot slot = {};
+            slot.step = steps[i];
+            slot.control = encoded;
+            slots.push_back(slot);
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (Slot &slot : slots) {
+            long ns = now.tv_nsec + (long)(slot.step.atMs % 1000) * 1000000L;
+            slot.due.tv_sec = now.tv_sec + slot.step.atMs / 1000 + ns / 1000000000L;
+            slot.due.tv_nsec = ns % 1000000000L;
+        }
+
+        pthread_attr_t attr;
+        struct sched_param param;
+        param.sched_priority = priority;
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+        realTime = pthread_create(&thread, &attr, run, this) == 0;
+        pthread_attr_destroy(&attr);
+
+        if (!realTime) {
+            TRACE_I("SCHED_FIFO not permitted, sequencing on a normal thread");
+            if (pthread_create(&thread, NULL, run, this) != 0) {
+                perror("Can't start the sequencer thread.");
+                return 1;
+            }
+        }
+        running = true;
+        return 0;
+    }
+
+    void *WaveformSequencer::run(void *self) {
+        ((WaveformSequencer*)self)->play();
+        return NULL;
+    }
+
+    void WaveformSequencer::play() {
+        for (size_t i = 0; i < slots.size(); i++) {
+            Slot &slot = slots[i];
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &slot.due, NULL) == EINTR) {}
+
+            struct timespec woke, applied;
+            clock_gettime(CLOCK_MONOTONIC, &woke);
+            rtc.writeRegister(CONTROL_REG, slot.control);
+            output(slot.step, userData);
+            clock_gettime(CLOCK_MONOTONIC, &applied);
+
+            slot.wakeErrorNs = elapsedNs(slot.due, woke);
+            slot.applyNs = elapsedNs(woke, applied);
+            TRACE_I("Step %d: SQW %d Hz, LED PWM %d%%", (int)i, slot.step.sqwFrequency,
+                    slot.step.ledOn ? slot.step.pwmDuty : 0);
+        }
+    }
+
+    // Wait for the last step to be applied
+    void WaveformSequencer::join() {
+        if (!running) return;
+        pthread_join(thread, NULL);
+        running = false;
+    }
+
+    // Print per-step timing error after join()
+    void WaveformSequencer::report() {
+        long worst = 0, total = 0;
+        printf("Sequencer timing (%s):\n", realTime ? "SCHED_FIFO" : "SCHED_OTHER");
+        for (size_t i = 0; i < slots.size(); i++) {
+            printf("  step %zu at %6u ms: wake error %7.1f us, RTC write + output %7.1f us\n", i,
+                   slots[i].step.atMs, slots[i].wakeErrorNs / 1000.0, slots[i].applyNs / 1000.0);
+            if (labs(slots[i].wakeErrorNs) > worst) worst = labs(slots[i].wakeErrorNs);
+            total += labs(slots[i].wakeErrorNs);
+        }
+        if (!slots.empty()) {
+            printf("  mean wake error %.1f us, worst %.1f us\n", total / 1000.0 / slots.size(), worst / 1000.0);
+        }
+    }
+
+} /* namespace een1071 */
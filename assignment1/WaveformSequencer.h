@@ -0,0 +1,66 @@
+/*
+ * WaveformSequencer.h
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ */
+
+#ifndef WAVEFORMSEQUENCER_H_
+#define WAVEFORMSEQUENCER_H_
+
+#include "DS3231.h"
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+
+namespace een1071 {
+
+    // One point of the timeline. The step stays in force until the next one starts.
+    struct WaveformStep {
+        unsigned int atMs;   // offset from the start of the sequence
+        int sqwFrequency;    // 1, 1024, 4096 or 8192 Hz, or 0 to go back to interrupt mode
+        int pwmDuty;         // LED PWM duty cycle in percent
+        bool ledOn;          // false keeps the LED off whatever the duty cycle
+    };
+
+    // Called on the sequencer thread right after the RTC write of each step
+    typedef void (*WaveformOutputFunc)(const WaveformStep &step, void *userData);
+
+    /**
+     * @brief Plays a timeline of SQW rate / PWM duty / LED steps on a dedicated SCHED_FIFO thread.
+     * Every step is woken with an absolute clock_nanosleep on CLOCK_MONOTONIC, so errors do not
+     * accumulate, and its control register value is encoded before the run starts, so a step costs
+     * exactly one RTC write.
+     */
+    class WaveformSequencer {
+    public:
+        WaveformSequencer(DS3231 &rtc);
+        ~WaveformSequencer() { join(); }
+        void setOutput(WaveformOutputFunc output, void *userData);
+        int start(const std::vector<WaveformStep> &steps, int priority = 50);
+        void join();
+        void report();
+
+    private:
+        struct Slot {
+            WaveformStep step;
+            unsigned char control;
+            struct timespec due;
+            long wakeErrorNs;    // actual wake-up minus due time
+            long applyNs;        // wake-up until the RTC write and output are done
+        };
+
+        static void *run(void *self);
+        void play();
+
+        DS3231 &rtc;
+        WaveformOutputFunc output;
+        void *userData;
+        std::vector<Slot> slots;
+        pthread_t thread;
+        bool running;
+        bool realTime;
+    };
+
+} /* namespace een1071 */
+
+#endif /* WAVEFORMSEQUENCER_H_ */
@@ -5,7 +5,22 @@
  */
 
 #include <iostream>
+#include "AsyncDS3231.h"
 #include "DS3231.h"
+#include "DS3231Sim.h"
+#include "I2CReplay.h"
+#include "Trace.h"
+#include "WaveformSequencer.h"
+#include "ShmRefclock.h"
+#include "RegisterWatch.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
 #include <pthread.h>
 #include <unistd.h>
 #include <pigpio.h>
@@ -13,62 +28,338 @@
 using namespace std;
 using namespace een1071;
 
+// Set by --replay: the bus and GPIO are not touched and the alarm waits are left to the replay pacing
+static bool replaying = false;
+
 void interruptCallback(int gpio, int level, uint32_t tick, void * userData) {
     DS3231 *rtc = (DS3231*)userData;
     // Trigger LED when interrupts happen
     rtc->triggerLED();
 }
 
-void blinkLED(DS3231 &rtc) {
+static void noOutput(const WaveformStep &, void *) {}
+
+void blinkLED(DS3231 &rtc, unsigned int stepMs) {
     cout << "\nDemonstrating Square Wave Functionality using PWM:" << endl;
 
     // pigpio functitons
-    gpioSetMode(LED_PIN, PI_OUTPUT);
-    gpioSetPWMrange(LED_PIN, 100);
-    gpioSetPWMfrequency(LED_PIN, 800);
-
-    // 1Hz - LED flickering with 100% duty cycle
-    cout << "\n1Hz - LED at high brightness" << endl;
-    rtc.enableSQW(1);
-    gpioPWM(LED_PIN, 100);
-    sleep(5);
-
-    // 1.024kHz - LED flickering with 75% duty cycle
-    cout << "\n1.024kHz - LED at medium brightness" << endl;
-    rtc.enableSQW(1024);
-    gpioPWM(LED_PIN, 75);
-    sleep(5);
-
-    // 4.096kHz - LED flickering with 50% duty cycle
-    cout << "\n4.096kHz - LED dimmer" << endl;
-    rtc.enableSQW(4096);
-    gpioPWM(LED_PIN, 50);
-    sleep(5);
-
-    // 8.192kHz - LED flickering with 25% duty cycle
-    cout << "\n8.192kHz - LED very dim" << endl;
-    rtc.enableSQW(8192);
-    gpioPWM(LED_PIN, 25);
-    sleep(5);
-
-    // Turn off PWM
-    gpioPWM(LED_PIN, 0);
-
-    rtc.disableSQW();
+    if (!replaying) {
+        gpioSetMode(LED_PIN, PI_OUTPUT);
+        gpioSetPWMrange(LED_PIN, 100);
+        gpioSetPWMfrequency(LED_PIN, 800);
+    }
+
+    // Each step holds for stepMs (5 seconds normally); the last one turns off PWM and goes back to interrupt mode
+    // 1Hz - LED at high brightness (100% duty cycle)
+    // 1.024kHz - LED at medium brightness (75% duty cycle)
+    // 4.096kHz - LED dimmer (50% duty cycle)
+    // 8.192kHz - LED very dim (25% duty cycle)
+    vector<WaveformStep> steps = {
+        {          0,    1, 100, true },
+        {     stepMs, 1024,  75, true },
+        { 2 * stepMs, 4096,  50, true },
+        { 3 * stepMs, 8192,  25, true },
+        { 4 * stepMs,    0,   0, false },
+    };
+
+    WaveformSequencer sequencer(rtc);
+    if (replaying) sequencer.setOutput(noOutput, nullptr);
+    if (sequencer.start(steps) != 0) {
+        cout << "Can't start the SQW/PWM sequence" << endl;
+        return;
+    }
+    sequencer.join();
+    trace::flush();
+    sequencer.report();
 }
 
-int main() {
+static volatile sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+// Export RTC time to chronyd/ntpd through NTP SHM unit 0, until Ctrl+C.
+// With `simulated`, a DS3231Sim set to the host time stands in for the chip and the SQW pin.
+int runRefclock(bool simulated) {
     DS3231 rtc(1, RTC_ADDR);
-    unsigned char status;
-    unsigned char control;
+    DS3231Sim sim;
+    ShmRefclock shm(0);
+    EdgeSource *edges;
+
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+
+    if (simulated) {
+        rtc.setTransport(&sim);
+        rtc.setTimeDate(true);
+        sim.registers[STATUS_REG] &= ~STATUS_OSF;   // the time is valid now
+        edges = new SimEdgeSource(sim);
+    } else {
+        if (gpioInitialise() < 0) {
+            perror("Can't initialize pigpio.");
+            return 1;
+        }
+        edges = new GpioEdgeSource(INT_SQW_PIN);
+    }
+
+    cout << "Publishing RTC time to NTP SHM unit 0, Ctrl+C to stop" << endl;
+    SqwRefclock refclock(rtc, *edges, shm);
+    int result = refclock.run(&stopRequested);
+    cout << "\nPublished " << refclock.published() << " samples, rejected " << refclock.rejected() << endl;
+
+    delete edges;
+    if (!simulated) gpioTerminate();
+    return result;
+}
+
+/**
+ * Measure the start-up path of a one-shot "read the RTC" tool: construct the driver and get the
+ * first valid time. One burst read of 0x00-0x0F returns the time and STATUS_REG together, so on
+ * the bus this is an open and a single I2C_RDWR ioctl. OSF set means the time is not valid.
+ * With `simulated`, a fresh DS3231Sim (OSF set, as at first power-up) stands in for the chip.
+ * @return 0 if the time is valid, 1 on a bus error, 2 if OSF is set
+ */
+int runColdStart(bool simulated) {
+    DS3231Sim sim;
+    struct timespec start, done;
+    unsigned char r[STATUS_REG + 1];
+    struct tm t;
 
-    if (gpioInitialise() < 0) {
-        perror("Can't initialize pigpio.");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DS3231 rtc(1, RTC_ADDR);
+    if (simulated) rtc.setTransport(&sim);
+    int failed = rtc.readRegistersInto(r, sizeof(r), RTC_SECONDS);
+    if (!failed) decodeTimeRegisters(r, t);
+    clock_gettime(CLOCK_MONOTONIC, &done);
+
+    if (failed) {
+        cout << "Can't read the RTC" << endl;
+        return 1;
+    }
+
+    unsigned char status = r[STATUS_REG];
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &t);
+    printf("RTC time %s\n", text);
+    printf("Construct to decoded time and status: %.1f us\n",
+           ((done.tv_sec - start.tv_sec) * 1e9 + (done.tv_nsec - start.tv_nsec)) / 1000.0);
+    if (status & STATUS_OSF) {
+        printf("Oscillator stop flag set (status 0x%02x): the time is not valid, set it first\n", status);
+        return 2;
+    }
+    printf("Oscillator has run since the time was set (status 0x%02x)\n", status);
+    return 0;
+}
+
+// Play the blinkLED() timeline against a DS3231Sim with no LED output, so the sequencer
+// timing can be checked (and SCHED_FIFO tried) without the chip or pigpio
+int runSequenceSim() {
+    DS3231 rtc(1, RTC_ADDR);
+    DS3231Sim sim;
+    rtc.setTransport(&sim);
+
+    vector<WaveformStep> steps = {
+        {    0,    1, 100, true },
+        {  500, 1024,  75, true },
+        { 1000, 4096,  50, true },
+        { 1500, 8192,  25, true },
+        { 2000,    0,   0, false },
+    };
+
+    WaveformSequencer sequencer(rtc);
+    sequencer.setOutput(noOutput, nullptr);
+    if (sequencer.start(steps) != 0) {
+        cout << "Can't start the SQW/PWM sequence" << endl;
         return 1;
     }
+    sequencer.join();
+    trace::flush();
+    sequencer.report();
+    cout << "Control Register (Hex): 0x" << hex << (int)sim.registers[CONTROL_REG] << dec << endl;
+    return 0;
+}
+
+#define ASYNC_EDGE_TASKS 2000
+#define ASYNC_EDGES_PER_TASK 5
+#define ASYNC_ALARM_TASKS 1000
+#define ASYNC_TICK_US 10000     // one simulated second, so the run takes a few wall-clock seconds
+
+// The simulated chip is shared by the RTC thread (bus transfers) and the ticker, so both lock it
+class LockedSim:public I2CTransport {
+public:
+    DS3231Sim sim;
+    mutex m;
+    unsigned long transfers = 0;
+
+    virtual int write(unsigned char address, const unsigned char *data, unsigned int length) {
+        lock_guard<mutex> lock(m);
+        transfers++;
+        return sim.write(address, data, length);
+    }
+
+    virtual int read(unsigned char address, unsigned char *data, unsigned int length) {
+        lock_guard<mutex> lock(m);
+        transfers++;
+        return sim.read(address, data, length);
+    }
+};
 
-    gpioSetMode(INT_SQW_PIN, PI_INPUT);
-    gpioSetMode(LED_PIN, PI_OUTPUT);
+static atomic<int> asyncTasksLeft;
+static atomic<int> asyncEdges;
+static atomic<int> asyncAlarms;
+static atomic<int> asyncEarly;   // an alarm resumed before its descriptor could have matched
+
+RtcTask edgeTask(AsyncDS3231 &rtc) {
+    for (int i = 0; i < ASYNC_EDGES_PER_TASK; i++) {
+        co_await rtc.nextEdge();
+        asyncEdges++;
+    }
+    asyncTasksLeft--;
+}
+
+// Reads the time before and after each wait; the wait must cover at least the seconds to the next match
+RtcTask alarmTask(AsyncDS3231 &rtc, AlarmDescriptor descriptor, int repeats) {
+    for (int i = 0; i < repeats; i++) {
+        struct tm before = co_await rtc.readTime();
+        if (co_await rtc.alarm(descriptor)) {
+            asyncEarly++;
+            break;
+        }
+        struct tm after = co_await rtc.readTime();
+        int target = descriptor.rate == ALARM_MATCH_SECONDS ? descriptor.second : 0;
+        int least = descriptor.rate == ALARM_EVERY_SECOND ? 1 : (target - before.tm_sec + 59) % 60 + 1;
+        if (timegm(&after) - timegm(&before) < least) asyncEarly++;
+        asyncAlarms++;
+    }
+    asyncTasksLeft--;
+}
+
+/**
+ * Run thousands of coroutines against AsyncDS3231 on one executor thread, with a DS3231Sim as the
+ * chip: edge waiters, and alarm waiters that share the two hardware alarms (every second and
+ * seconds matches on alarm 1, every minute on alarm 2). Simulated seconds pass every ASYNC_TICK_US
+ * and each is reported through onInterrupt(), standing in for the INT/SQW edge.
+ * @return 0 if every task finished and no alarm resumed early, 1 otherwise
+ */
+int runAsyncSim() {
+    LockedSim bus;
+    DS3231 rtc(1, RTC_ADDR);
+    rtc.setTransport(&bus);
+    rtc.setTimeDate(true);
+    bus.sim.registers[STATUS_REG] &= ~STATUS_OSF;
+
+    RtcExecutor executor;
+    thread executorThread([&] { executor.run(); });
+    int simulated = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    {
+        AsyncDS3231 async(rtc, executor);
+        asyncTasksLeft = ASYNC_EDGE_TASKS + ASYNC_ALARM_TASKS;
+        for (int i = 0; i < ASYNC_EDGE_TASKS; i++) edgeTask(async).spawn(executor);
+        for (int i = 0; i < ASYNC_ALARM_TASKS; i++) {
+            AlarmDescriptor descriptor = {};
+            if (i % 3 == 0) {
+                descriptor.alarm = 1;
+                descriptor.rate = ALARM_EVERY_SECOND;
+            } else if (i % 3 == 1) {
+                descriptor.alarm = 1;
+                descriptor.rate = ALARM_MATCH_SECONDS;
+                descriptor.second = (i * 7) % 60;
+            } else {
+                descriptor.alarm = 2;
+                descriptor.rate = ALARM_EVERY_MINUTE;
+            }
+            alarmTask(async, descriptor, 2).spawn(executor);
+        }
+
+        while (asyncTasksLeft > 0 && simulated < 300) {
+            usleep(ASYNC_TICK_US);
+            {
+                lock_guard<mutex> lock(bus.m);
+                bus.sim.tick();
+            }
+            simulated++;
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            async.onInterrupt(now);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    executor.stop();
+    executorThread.join();
+
+    printf("%d simulated seconds in %.2f s: %d edges and %d alarms resumed, %d tasks unfinished, %d early\n",
+           simulated, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+           asyncEdges.load(), asyncAlarms.load(), asyncTasksLeft.load(), asyncEarly.load());
+    printf("%lu bus transfers for %d waiting tasks\n", bus.transfers, ASYNC_EDGE_TASKS + ASYNC_ALARM_TASKS);
+    return asyncTasksLeft == 0 && asyncEarly == 0 ? 0 : 1;
+}
+
+// Print every change of registers start..start+count-1 (default 0x00-0x12) as it happens, until Ctrl+C
+int runWatch(bool binary, int argc, char *argv[]) {
+    unsigned long start = argc > 2 ? strtoul(argv[2], NULL, 0) : RTC_SECONDS;
+    unsigned long count = argc > 3 ? strtoul(argv[3], NULL, 0) : DS3231_REG_COUNT - start;
+    if (start >= DS3231_REG_COUNT || count == 0 || start + count > DS3231_REG_COUNT) {
+        fprintf(stderr, "Usage: rtc %s [start [count]], registers 0x00-0x%02x\n", argv[1], DS3231_REG_COUNT - 1);
+        return 1;
+    }
+    DS3231 rtc(1, RTC_ADDR);
+    RegisterWatch watch(rtc, start, count);
+
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+
+    int result = watch.run(stdout, binary, &stopRequested);
+    fprintf(stderr, "\n%lu snapshots, %lu changes\n", watch.snapshots(), watch.changes());
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--refclock") == 0) return runRefclock(false);
+    if (argc > 1 && strcmp(argv[1], "--refclock-sim") == 0) return runRefclock(true);
+    if (argc > 1 && strcmp(argv[1], "--watch") == 0) return runWatch(false, argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--watch-binary") == 0) return runWatch(true, argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--sequence-sim") == 0) return runSequenceSim();
+    if (argc > 1 && strcmp(argv[1], "--cold-start") == 0) return runColdStart(false);
+    if (argc > 1 && strcmp(argv[1], "--cold-start-sim") == 0) return runColdStart(true);
+    if (argc > 1 && strcmp(argv[1], "--async-sim") == 0) return runAsyncSim();
+
+    // --record <file> saves every I2C transfer of the demo, --replay <file> runs the demo against
+    // such a recording (back to back, or at the recorded speed with --realtime)
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    bool realTime = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+        else if (strcmp(argv[i], "--realtime") == 0) realTime = true;
+    }
+
+    DS3231 rtc(1, RTC_ADDR);
+    // The alarm callback runs on a pigpio thread, so it gets its own device and stays out of the recording
+    DS3231 alertRtc(1, RTC_ADDR);
+    I2CReplay replay(realTime);
+    unsigned char status;
+    unsigned char control;
+
+    if (replayPath) {
+        if (replay.load(replayPath) != 0) return 1;
+        rtc.setTransport(&replay);
+        rtc.setTimeSource(I2CReplay::timeSource, &replay);
+        replaying = true;
+    } else {
+        if (recordPath && rtc.startRecording(recordPath) != 0) return 1;
+
+        if (gpioInitialise() < 0) {
+            perror("Can't initialize pigpio.");
+            return 1;
+        }
+
+        gpioSetMode(INT_SQW_PIN, PI_INPUT);
+        gpioSetMode(LED_PIN, PI_OUTPUT);
+    }
 
     status = rtc.readRegister(STATUS_REG);
     cout << "Status Register before clearing: 0x" << hex << (int)status << dec << endl;
@@ -80,7 +371,8 @@ int main() {
     cout << "\nClearing all time/date registers:" << endl;
     rtc.clearTimeDate();
 
-    // Let user choose time format:
+    // Let user choose time format (driver output is drained asynchronously, so flush it before prompting):
+    trace::flush();
     int format;
     cout << "\nChoose time format (24/12): ";
     cin >> format;
@@ -107,10 +399,10 @@ int main() {
 
     rtc.setAlarmOne();
     // pigpio needs a callback for interrupts
-    gpioSetAlertFuncEx(INT_SQW_PIN, interruptCallback, &rtc);
+    if (!replaying) gpioSetAlertFuncEx(INT_SQW_PIN, interruptCallback, &alertRtc);
 
     cout << "Waiting for 60 seconds..." << endl;
-    sleep(60);  // Wait for 60 seconds to trigger alarm
+    if (!replaying) sleep(60);  // Wait for 60 seconds to trigger alarm
 
     cout << "\nChecking if alarm triggered:" << endl;
 
@@ -138,7 +430,7 @@ int main() {
     rtc.setAlarmTwo();
 
     cout << "Waiting for another 60 seconds..." << endl;
-    sleep(60);  // Wait for another 60 seconds to trigger alarm
+    if (!replaying) sleep(60);  // Wait for another 60 seconds to trigger alarm
 
     cout << "\nChecking if alarm triggered:" << endl;
 
@@ -161,17 +453,26 @@ int main() {
      // Disable interrupt handler before switching to square wave
     cout << "Disabling interrupt handler..." << endl;
     // No interrupt callbacks here, setting sqw
-    gpioSetAlertFuncEx(INT_SQW_PIN, NULL, NULL);
+    if (!replaying) gpioSetAlertFuncEx(INT_SQW_PIN, NULL, NULL);
 
     // Clear status register
     status = rtc.readRegister(STATUS_REG);
     rtc.writeRegister(STATUS_REG, 0x00);
 
-    // Testing SQW and PWM
-    blinkLED(rtc);
+    // Testing SQW and PWM (a fast replay doesn't wait between the steps)
+    blinkLED(rtc, replaying && !realTime ? 0 : 5000);
 
     cout << "\nProgram complete." << endl;
 
+    if (replaying) {
+        trace::flush();
+        cout << "Replayed " << replay.position() << " of " << replay.size() << " transfers, "
+             << replay.divergences() << " divergences" << endl;
+        return replay.divergences() || !replay.finished() ? 1 : 0;
+    }
+
+    rtc.stopRecording();
+
     // Terminate GPIO and pigpio usage
     gpioTerminate();
 
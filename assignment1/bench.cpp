@@ -0,0 +1,124 @@
+/*
+ * bench.cpp
+ * Copyright (c) 2025 Derek Molloy (www.derekmolloy.ie)
+ * Modified by: Arina Sofiyeva
+ *
+ * Micro-benchmarks run against a DS3231Sim, so no hardware is needed. Diagnostics go to stdout and
+ * the timings to stderr, so run it as: ./bench > /dev/null
+ */
+
+#include "DS3231.h"
+#include "BasicDS3231.h"
+#include "DS3231Sim.h"
+#include "I2CBus.h"
+#include "Trace.h"
+#include <iostream>
+#include <stdio.h>
+#include <time.h>
+
+using namespace std;
+using namespace een1071;
+
+#define POLL_ITERATIONS 200000
+#define READ_ITERATIONS 1000000
+#define BUS_ITERATIONS 1000
+
+static double nowNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *name, double startNs, int iterations) {
+    fprintf(stderr, "  %-36s %8.1f ns/iteration\n", name, (nowNs() - startNs) / iterations);
+}
+
+// Poll the seconds register and log it each time, as the driver's diagnostics used to
+static void benchPolling(DS3231 &rtc) {
+    fprintf(stderr, "Polling loop, one diagnostic line per read:\n");
+    double start = nowNs();
+    for (int i = 0; i < POLL_ITERATIONS; i++) {
+        int sec = rtc.readRegister(RTC_SECONDS);
+        cout << "Register 0x" << hex << RTC_SECONDS << " value: 0x" << sec << dec << endl;
+    }
+    report("cout << ... << endl", start, POLL_ITERATIONS);
+
+    // Flushed after every ring's worth of records, so none is dropped and the time includes
+    // formatting and writing each one on the drain thread, not just the push
+    trace::flush();
+    unsigned long droppedBefore = trace::dropped();
+    start = nowNs();
+    for (int i = 0; i < POLL_ITERATIONS; i++) {
+        int sec = rtc.readRegister(RTC_SECONDS);
+        TRACE_I("Register 0x%x value: 0x%x", RTC_SECONDS, sec);
+        if ((i + 1) % TRACE_RING_SIZE == 0) trace::flush();
+    }
+    trace::flush();
+    report("TRACE_I (ring, drained)", start, POLL_ITERATIONS);
+    if (trace::dropped() != droppedBefore) {
+        fprintf(stderr, "  %lu trace records dropped, TRACE_I timing is not valid\n", trace::dropped() - droppedBefore);
+    }
+
+    start = nowNs();
+    for (int i = 0; i < POLL_ITERATIONS; i++) {
+        int sec = rtc.readRegister(RTC_SECONDS);
+        TRACE_D("Register 0x%x value: 0x%x", RTC_SECONDS, sec);
+        (void)sec;
+    }
+    report(RTC_TRACE_LEVEL >= TRACE_DEBUG ? "TRACE_D (enabled)" : "TRACE_D (compiled out)", start, POLL_ITERATIONS);
+}
+
+// Keeps the compiler from dropping the timed reads
+static volatile long long sink;
+
+/**
+ * Read the time registers, decode them and convert to epoch seconds, through the virtual DS3231
+ * (virtual transport calls, out-of-line decoding) and through BasicDS3231<DS3231Sim>, where the
+ * whole sequence can inline. Both run against the same simulated register file.
+ */
+static void benchReadTime(DS3231 &rtc, DS3231Sim &sim) {
+    BasicDS3231<DS3231Sim> basic(sim);
+    struct tm t;
+
+    fprintf(stderr, "Read time + decode + epoch seconds, simulated chip:\n");
+    double start = nowNs();
+    for (int i = 0; i < READ_ITERATIONS; i++) {
+        if (rtc.readTime(t) == 0) sink = BasicDS3231<DS3231Sim>::epochSeconds(t);
+    }
+    report("DS3231 (virtual transport)", start, READ_ITERATIONS);
+
+    start = nowNs();
+    for (int i = 0; i < READ_ITERATIONS; i++) {
+        sink = basic.readEpoch();
+    }
+    report("BasicDS3231<DS3231Sim>", start, READ_ITERATIONS);
+}
+
+// The same read over /dev/i2c-1, where the bus transfer dominates; skipped without the chip
+static void benchBus() {
+    I2CBus bus(1);
+    BasicDS3231<I2CBus> basic(bus);
+
+    fprintf(stderr, "Read time + decode + epoch seconds, /dev/i2c-1:\n");
+    if (basic.readEpoch() < 0) {
+        fprintf(stderr, "  skipped, no DS3231 on /dev/i2c-1\n");
+        return;
+    }
+    double start = nowNs();
+    for (int i = 0; i < BUS_ITERATIONS; i++) {
+        sink = basic.readEpoch();
+    }
+    report("BasicDS3231<I2CBus>", start, BUS_ITERATIONS);
+}
+
+int main() {
+    DS3231Sim sim;
+    DS3231 rtc(1, RTC_ADDR);
+    rtc.setTransport(&sim);
+
+    benchPolling(rtc);
+    benchReadTime(rtc, sim);
+    benchBus();
+    trace::flush();
+    return 0;
+}